@@ -1,194 +1,73 @@
-#include <atomic>
-#include <chrono>
+#include <cctype>
 #include <iostream>
-#include <thread>
+#include <string>
 #include <vector>
-#include <random>
-#include <cstdint>
-#include <numeric>
-#include <pthread.h>
 
-constexpr size_t TUPLES_PER_EXPERIMENT = 1 << 24;
-constexpr size_t TUPLE_SIZE = 16;
-constexpr size_t PAGE_SIZE = 256 * 1024 * 1024;
-constexpr int NUM_REPEATS = 8;
+#include "partition/benchmark.h"
 
-struct Tuple
+static void usage(const char *program)
 {
-    uint64_t key;
-    uint64_t payload;
-};
-
-struct PartitionBuffer
-{
-    alignas(64) std::atomic<uint32_t> write_idx;
-    uint32_t capacity;
-    Tuple *data;
-};
-
-struct SharedBuffers
-{
-    PartitionBuffer *partitions;
-    uint32_t num_partitions;
-};
-
-inline uint32_t partition_hash(uint64_t key, uint32_t b)
-{
-    return key & ((1u << b) - 1);
+    std::cerr << "Usage: " << program << " <num_threads> <core_id1> <core_id2> ... [first-touch|local|interleave|node<N>]\n"
+              << "       " << program << " <num_threads> <compact|scatter|physical-cores-first|smt-pairs|node<N>> [num_pus]"
+              << " [first-touch|local|interleave|node<N>]\n"
+              << "With a pinning policy the threads share the first num_pus PUs of its order (default: one PU each).\n";
 }
 
-void generate_input(Tuple *data, size_t count)
+static bool is_number(const char *arg)
 {
-    std::mt19937_64 rng(42);
-    std::uniform_int_distribution<uint64_t> dist;
-    for (size_t i = 0; i < count; ++i)
-    {
-        data[i].key = dist(rng);
-        data[i].payload = 0;
-    }
+    return *arg != '\0' && std::string(arg).find_first_not_of("0123456789") == std::string::npos;
 }
 
-bool init_buffers(SharedBuffers &buffers, uint32_t b)
+int main(int argc, char *argv[])
 {
-    buffers.num_partitions = 1u << b;
-    if (buffers.num_partitions > (1 << 18))
+    if (argc < 3)
     {
-        std::cerr << "Too many partitions (" << buffers.num_partitions << "). Aborting.\n";
-        return false;
+        usage(argv[0]);
+        return 1;
     }
-    buffers.partitions = new PartitionBuffer[buffers.num_partitions];
-    uint32_t expected_per_partition = TUPLES_PER_EXPERIMENT / buffers.num_partitions;
-    uint32_t capacity = static_cast<uint32_t>(expected_per_partition * 2);
 
-    for (uint32_t i = 0; i < buffers.num_partitions; ++i)
+    uint32_t threads = std::stoi(argv[1]);
+    PartitionOptions opts;
+    int next = 2;
+    if (is_number(argv[2]))
     {
-        buffers.partitions[i].write_idx.store(0);
-        buffers.partitions[i].capacity = capacity;
-        try
+        // Explicit core ids
+        if (argc != static_cast<int>(threads + 2) && argc != static_cast<int>(threads + 3))
         {
-            buffers.partitions[i].data = new Tuple[capacity];
+            std::cerr << "Error: Expected " << threads << " core IDs, but got " << (argc - 2) << "\n";
+            return 1;
         }
-        catch (const std::bad_alloc &e)
+        for (uint32_t i = 0; i < threads; ++i)
         {
-            std::cerr << "Memory allocation failed for partition " << i << ": " << e.what() << "\n";
-            return false;
-        }
-        for (uint32_t j = 0; j < capacity; j += PAGE_SIZE / sizeof(Tuple))
-        {
-            buffers.partitions[i].data[j].key = 0;
+            opts.cores.push_back(std::stoi(argv[2 + i]));
         }
+        next = 2 + threads;
     }
-    return true;
-}
-
-double run_concurrent_partition(uint32_t threads, uint32_t b, const std::vector<int> &core_ids)
-{
-    Tuple *input = new Tuple[TUPLES_PER_EXPERIMENT];
-    generate_input(input, TUPLES_PER_EXPERIMENT);
-
-    SharedBuffers buffers;
-    if (!init_buffers(buffers, b))
+    else
     {
-        delete[] input;
-        return -1.0;
-    }
-
-    size_t chunk_size = TUPLES_PER_EXPERIMENT / threads;
-    auto start = std::chrono::high_resolution_clock::now();
-
-    std::vector<std::thread> workers(threads);
-    for (uint32_t t = 0; t < threads; ++t)
-    {
-        workers[t] = std::thread([&, t]()
-                                 {
-            size_t offset = t * chunk_size;
-            size_t count = (t == threads - 1) ? TUPLES_PER_EXPERIMENT - offset : chunk_size;
-            Tuple* local = input + offset;
-
-            for (size_t i = 0; i < count; ++i) {
-                uint32_t p = partition_hash(local[i].key, b);
-                uint32_t idx = buffers.partitions[p].write_idx.fetch_add(1, std::memory_order_relaxed);
-                if (idx >= buffers.partitions[p].capacity) {
-                    std::cerr << "Buffer overflow at partition " << p << ", idx = " << idx << "\n";
-                    std::abort();
-                }
-                buffers.partitions[p].data[idx] = local[i];
-            } });
-
-        cpu_set_t cpuset;
-        CPU_ZERO(&cpuset);
-        CPU_SET(core_ids[t], &cpuset);
-        int rc = pthread_setaffinity_np(workers[t].native_handle(), sizeof(cpu_set_t), &cpuset);
-        if (rc != 0)
+        // Pinning policy over the discovered topology; fewer PUs than threads oversubscribes them
+        PinningPolicy policy;
+        int node = 0;
+        if (!parse_pinning_policy(argv[2], policy, node))
         {
-            std::cerr << "Error setting affinity for thread " << t << ": " << rc << "\n";
+            usage(argv[0]);
+            return 1;
         }
+        uint32_t num_pus = threads;
+        next = 3;
+        if (argc > next && is_number(argv[next]))
+            num_pus = std::stoi(argv[next++]);
+        opts.cores = pin_cores(policy, num_pus, node);
     }
 
-    for (auto &t : workers)
-        t.join();
-    auto end = std::chrono::high_resolution_clock::now();
-
-    delete[] input;
-    for (uint32_t i = 0; i < buffers.num_partitions; ++i)
-        delete[] buffers.partitions[i].data;
-    delete[] buffers.partitions;
-
-    std::chrono::duration<double> duration = end - start;
-    return TUPLES_PER_EXPERIMENT / (duration.count() * 1e6);
-}
-
-int main(int argc, char *argv[])
-{
-
-    // if (argc < 3)
-    // {
-    //     std::cerr << "Usage: " << argv[0] << " <num_threads> <core_id1> <core_id2> ...\n";
-    //     return 1;
-    // }
-    std::cout << "DEBUG: argc = " << argc << "\n";
-    for (int i = 0; i < argc; ++i)
-    {
-        std::cout << "argv[" << i << "] = '" << argv[i] << "'\n";
-    }
-
-    uint32_t threads = std::stoi(argv[1]);
-    // if (argc < static_cast<int>(threads + 2))
-    // {
-    //     std::cerr << "Insufficient core IDs provided for " << threads << " threads.\n";
-    //     return 1;
-    // }
-    if (argc != static_cast<int>(threads + 2))
+    // Optional NUMA placement last
+    if (argc > next && !parse_numa_policy(argv[next], opts.numa, opts.numa_node))
     {
-        std::cerr << "Error: Expected " << threads << " core IDs, but got " << (argc - 2) << "\n";
+        std::cerr << "Unknown NUMA policy: " << argv[next] << "\n";
         return 1;
     }
+    report_placement(opts);
 
-    std::vector<int> core_ids;
-    for (uint32_t i = 0; i < threads; ++i)
-    {
-        core_ids.push_back(std::stoi(argv[2 + i]));
-    }
-
-    std::vector<uint32_t> hash_bits = {4, 6, 8, 10, 12, 14, 16};
-    for (auto b : hash_bits)
-    {
-        std::vector<double> results;
-        for (int i = 0; i < NUM_REPEATS; ++i)
-        {
-            double throughput = run_concurrent_partition(threads, b, core_ids);
-            if (throughput < 0.0)
-                break;
-            results.push_back(throughput);
-        }
-
-        if (results.size() == NUM_REPEATS)
-        {
-            double avg = std::accumulate(results.begin(), results.end(), 0.0) / results.size();
-            std::cout << "Threads: " << threads
-                      << ", Hash Bits: " << b
-                      << ", Throughput: " << avg << " MTuple/s\n";
-        }
-    }
+    run_sweep<ConcurrentOutput>({threads}, {4, 6, 8, 10, 12, 14, 16}, opts);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,12 @@
+#include <vector>
+
+#include "partition/benchmark.h"
+
+int main()
+{
+    std::vector<uint32_t> thread_counts = {1, 2, 4, 8, 16, 32};
+    std::vector<uint32_t> hash_bits = {4, 6, 8, 10, 12, 14, 16, 18};
+    run_sweep<CountThenMove>(thread_counts, hash_bits);
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "partition/aggregate.h"
+#include "partition/bench_config.h"
+
+static void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " <tuples> <groups> [threads,...] [adaptive|local|partitioned,...]"
+              << " [concurrent|independent] [uniform|zipf[:theta]|selfsimilar[:h]]\n"
+              << "Computes COUNT, SUM, MIN and MAX of the payload grouped by key over keys drawn from <groups>\n"
+              << "distinct values (uniformly or skewed), with every aggregation mode (default: all three).\n";
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<uint32_t> thread_counts = {1, 2, 4, 8};
+    std::vector<AggregationMode> modes = {AggregationMode::Adaptive, AggregationMode::Local, AggregationMode::Partitioned};
+    std::string strategy = IndependentOutput::name;
+    InputSpec spec;
+    size_t tuples = 0;
+    try
+    {
+        if (argc < 3 || (tuples = std::stoull(argv[1])) == 0 || (spec.domain = std::stoull(argv[2])) == 0)
+            throw std::invalid_argument("sizes");
+        if (argc > 3 && !parse_number_list(argv[3], thread_counts, 1))
+            throw std::invalid_argument("threads");
+        if (argc > 4)
+        {
+            modes.clear();
+            std::stringstream in(argv[4]);
+            for (std::string name; std::getline(in, name, ',');)
+            {
+                AggregationMode mode;
+                if (!parse_aggregation_mode(name, mode))
+                    throw std::invalid_argument("mode");
+                modes.push_back(mode);
+            }
+        }
+        if (argc > 5)
+        {
+            strategy = argv[5];
+            if (strategy != ConcurrentOutput::name && strategy != IndependentOutput::name)
+                throw std::invalid_argument("strategy");
+        }
+        const uint64_t groups = spec.domain;
+        if (argc > 6 && (!parse_input_spec(argv[6], spec) || spec.distribution == KeyDistribution::Sequential ||
+                         spec.distribution == KeyDistribution::Duplicates))
+            throw std::invalid_argument("distribution");
+        spec.domain = groups;
+    }
+    catch (const std::exception &)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    // Uniform keys over the groups are the duplicates distribution with `groups` distinct keys
+    if (spec.distribution == KeyDistribution::Uniform)
+        spec.distribution = KeyDistribution::Duplicates;
+
+    PartitionOptions opts;
+    // Few groups leave most partitions empty and the rest far above the uniform share:
+    // growable buffers take any of them without overflowing
+    opts.buffers = BufferSizing::Growable;
+    std::cerr << "Input: " << describe_input(spec) << " over " << spec.domain << " groups, "
+              << cache_resident_groups() << " groups fit in cache\n";
+    bool ok = true;
+    for (uint32_t threads : thread_counts)
+    {
+        WorkerPool pool(threads, opts.cores);
+        AlignedArray<Tuple> input = prepare_input(pool, opts, spec, tuples);
+        for (AggregationMode mode : modes)
+        {
+            visit_strategy(strategy, [&](auto s)
+                           {
+                using Strategy = typename decltype(s)::type;
+                AggregationResult<Strategy> result;
+                std::vector<double> results;
+                // One warm-up run allocates and faults in the partitions and tables
+                for (int i = 0; i <= NUM_REPEATS; ++i)
+                {
+                    if (!aggregate_into<Strategy>(result, input.get(), tuples, pool, opts, mode))
+                    {
+                        std::cerr << "Skipping " << aggregation_mode_name(mode) << " with " << threads << " threads\n";
+                        ok = false;
+                        return;
+                    }
+                    if (i > 0)
+                        results.push_back(result.throughput());
+                }
+                uint64_t count = 0, sum = 0;
+                result.for_each_group([&](const Aggregate& a) {
+                    count += a.count;
+                    sum += a.sum;
+                });
+                std::cout << "Mode: " << aggregation_mode_name(mode) << (result.partitioned ? " (" + strategy + ", " +
+                             std::to_string(result.bits) + " bits)" : " (local tables)")
+                          << ", Threads: " << threads << ", Throughput: " << average(results) << " MTuple/s, Groups: "
+                          << result.groups();
+                if (mode == AggregationMode::Adaptive)
+                    std::cout << ", Estimated groups: " << static_cast<uint64_t>(result.estimated_groups);
+                std::cout << ", Count: " << count << ", Sum: " << sum << "\n"; });
+        }
+    }
+    return ok ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,108 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "partition/bench_config.h"
+#include "partition/join.h"
+
+static void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " <build tuples> <probe tuples> [threads,...] [strategy,...|all] [bits|auto]"
+              << " [uniform|zipf[:theta]|selfsimilar[:h]|sequential|duplicates[:distinct]]\n"
+              << "Joins a build relation of unique random keys with a probe relation whose keys are drawn from it\n"
+              << "(skewed as the last argument asks), partitioning both with each strategy (default multi_pass).\n"
+              << "auto bits fit a build partition and its hash table in half the L2 cache.\n";
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<uint32_t> thread_counts = {1, 2, 4, 8};
+    std::vector<std::string> strategies = {MultiPass::name};
+    InputSpec probe_spec;
+    probe_spec.seed = 7;
+    size_t build_n = 0, probe_n = 0;
+    uint32_t bits = 0;
+    bool auto_bits = true;
+    try
+    {
+        if (argc < 3 || (build_n = std::stoull(argv[1])) == 0 || (probe_n = std::stoull(argv[2])) == 0)
+            throw std::invalid_argument("sizes");
+        if (argc > 3 && !parse_number_list(argv[3], thread_counts, 1))
+            throw std::invalid_argument("threads");
+        if (argc > 4 && std::string(argv[4]) == "all")
+            strategies = {ConcurrentOutput::name, IndependentOutput::name, CountThenMove::name, ParallelBuffers::name,
+                          MultiPass::name};
+        else if (argc > 4)
+        {
+            strategies.clear();
+            std::stringstream in(argv[4]);
+            for (std::string name; std::getline(in, name, ',');)
+            {
+                if (!visit_strategy(name, [](auto) {}))
+                    throw std::invalid_argument("strategy");
+                strategies.push_back(name);
+            }
+        }
+        if (argc > 5 && std::string(argv[5]) != "auto")
+        {
+            auto_bits = false;
+            bits = std::stoul(argv[5]);
+            if (bits > JOIN_MAX_BITS)
+                throw std::invalid_argument("bits");
+        }
+        if (argc > 6 && !parse_input_spec(argv[6], probe_spec))
+            throw std::invalid_argument("distribution");
+    }
+    catch (const std::exception &)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (auto_bits)
+        bits = join_bits(build_n);
+
+    PartitionOptions opts;
+    // Growable buffers take the skew of the probe side without overflowing
+    if (probe_spec.distribution != KeyDistribution::Uniform)
+        opts.buffers = BufferSizing::Growable;
+    bool ok = true;
+    for (uint32_t threads : thread_counts)
+    {
+        WorkerPool pool(threads, opts.cores);
+        AlignedArray<Tuple> build = prepare_input(pool, opts, InputSpec{}, build_n);
+        AlignedArray<Tuple> probe(probe_n, opts.pages);
+        place_array(probe, opts.numa, opts.numa_node, threads, opts.cores);
+        generate_probe(probe.get(), probe_n, build.get(), build_n, probe_spec, pool);
+
+        for (const std::string &name : strategies)
+        {
+            visit_strategy(name, [&](auto s)
+                           {
+                using Strategy = typename decltype(s)::type;
+                JoinResult<Strategy> result;
+                double build_s = 0.0, probe_s = 0.0, join_s = 0.0;
+                // One warm-up run allocates and faults in the partitions and tables
+                for (int i = 0; i <= NUM_REPEATS; ++i)
+                {
+                    if (!hash_join_into<Strategy>(result, build.get(), build_n, probe.get(), probe_n, bits, pool, opts))
+                    {
+                        std::cerr << "Skipping " << name << " with " << threads << " threads\n";
+                        ok = false;
+                        return;
+                    }
+                    if (i == 0)
+                        continue;
+                    build_s += result.build.seconds / NUM_REPEATS;
+                    probe_s += result.probe.seconds / NUM_REPEATS;
+                    join_s += result.join_seconds / NUM_REPEATS;
+                }
+                const double total = build_s + probe_s + join_s;
+                std::cout << "Strategy: " << name << ", Threads: " << threads << ", Hash Bits: " << bits
+                          << ", Partition build: " << build_s * 1000.0 << " ms, Partition probe: " << probe_s * 1000.0
+                          << " ms, Join: " << join_s * 1000.0 << " ms, Throughput: " << (build_n + probe_n) / total / 1e6
+                          << " MTuple/s, Matches: " << result.matches << ", Checksum: " << result.checksum << "\n"; });
+        }
+    }
+    return ok ? 0 : EXIT_FAILURE;
+}
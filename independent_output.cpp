@@ -0,0 +1,39 @@
+#include <iostream>
+#include <vector>
+
+#include "partition/benchmark.h"
+
+int main(int argc, char *argv[])
+{
+    // Optional scatter mode: "direct" (default) or "swwc", page size: "4k" (default), "thp", "2m" or "1g",
+    // NUMA placement: "first-touch" (default), "local", "interleave" or "node<N>",
+    // pinning: "none" (default), "compact", "scatter", "physical-cores-first", "smt-pairs" or "node<N>",
+    // key distribution: "uniform" (default), "zipf[:theta]", "selfsimilar[:h]", "sequential" or "duplicates[:distinct]",
+    // and buffer sizing: "fixed" (default), "skew-resilient" or "growable"
+    PartitionOptions opts;
+    InputSpec spec;
+    PinningPolicy pinning = PinningPolicy::None;
+    int pin_node = 0;
+    if ((argc > 1 && !parse_scatter_mode(argv[1], opts.scatter)) || (argc > 2 && !parse_page_size(argv[2], opts.pages)) ||
+        (argc > 3 && !parse_numa_policy(argv[3], opts.numa, opts.numa_node)) ||
+        (argc > 4 && !parse_pinning_policy(argv[4], pinning, pin_node)) || (argc > 5 && !parse_input_spec(argv[5], spec)) ||
+        (argc > 6 && !parse_buffer_sizing(argv[6], opts.buffers)))
+    {
+        std::cerr << "Usage: " << argv[0] << " [direct|swwc] [4k|thp|2m|1g] [first-touch|local|interleave|node<N>]"
+                  << " [none|compact|scatter|physical-cores-first|smt-pairs|node<N>]"
+                  << " [uniform|zipf[:theta]|selfsimilar[:h]|sequential|duplicates[:distinct]] [fixed|skew-resilient|growable]\n";
+        return 1;
+    }
+    // The sweep's largest thread count; smaller counts use a prefix of the same order
+    opts.cores = pin_cores(pinning, 32, pin_node);
+    report_placement(opts);
+    report_input(spec, 10);
+    if (opts.scatter == ScatterMode::WriteCombine)
+        std::cerr << "Write-combining scatter with " << detect_stream_kernel().name << " streaming stores\n";
+
+    std::vector<uint32_t> thread_counts = {1, 2, 4, 8, 16, 32};
+    std::vector<uint32_t> hash_bits = {4, 6, 8, 10, 12, 14, 16, 18};
+    run_sweep<IndependentOutput>(thread_counts, hash_bits, opts, spec);
+
+    return 0;
+}
@@ -0,0 +1,251 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "partition/hash.h"
+#include "partition/input.h"
+#include "partition/memory.h"
+#include "partition/range_partition.h"
+#include "partition/scatter.h"
+#include "partition/tuple.h"
+
+/* Microbenchmarks of the hot loops in isolation: the hash functions, the partition id
+   kernels, the histogram and the scatter variants, on one thread. Every benchmark takes
+   (fan-out bits, input bytes); the input sizes span L1, L2, LLC and DRAM working sets.
+   ns_per_tuple is the figure to compare across commits, e.g.
+   ./microbenchmarks --benchmark_filter='Scatter.+bits:12/' --benchmark_repetitions=5
+*/
+
+static const std::vector<int64_t> FANOUT_BITS = {1, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20};
+static const std::vector<int64_t> INPUT_BYTES = {16 << 10, 256 << 10, 8 << 20, 256 << 20};
+
+// Uniform input of `bytes`, generated once per size and shared by all benchmarks
+static const AlignedArray<Tuple> &input_of(size_t bytes)
+{
+    static std::map<size_t, AlignedArray<Tuple>> inputs;
+    AlignedArray<Tuple> &input = inputs[bytes];
+    if (input.size() == 0)
+    {
+        input = AlignedArray<Tuple>(bytes / sizeof(Tuple), CACHE_LINE_SIZE);
+        generate_input(input.get(), input.size());
+    }
+    return input;
+}
+
+static void report_tuples(benchmark::State &state, size_t n)
+{
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n));
+    state.counters["ns_per_tuple"] = benchmark::Counter(static_cast<double>(state.iterations() * n),
+                                                        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+/* Run the benchmark with the kernels at `level` (skipped above what the CPU offers),
+   restoring the detected level afterwards
+*/
+class SimdScope
+{
+public:
+    SimdScope(benchmark::State &state, SimdLevel level) : saved_(active_simd_level())
+    {
+        ok_ = level <= detect_simd_level();
+        if (!ok_)
+            state.SkipWithError("SIMD level not supported by this CPU");
+        else
+            active_simd_level() = level;
+    }
+    ~SimdScope() { active_simd_level() = saved_; }
+
+    bool ok() const { return ok_; }
+
+private:
+    SimdLevel saved_;
+    bool ok_;
+};
+
+// One scalar hash per key
+template <typename HashFn>
+static void BM_Hash(benchmark::State &state)
+{
+    const uint32_t bits = static_cast<uint32_t>(state.range(0));
+    const AlignedArray<Tuple> &input = input_of(state.range(1));
+    const HashFn hash;
+    for (auto _ : state)
+    {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < input.size(); ++i)
+            sum += hash(input[i].key, bits);
+        benchmark::DoNotOptimize(sum);
+    }
+    report_tuples(state, input.size());
+}
+
+// Partition ids in batches, as the scatter loops compute them
+template <typename HashFn, SimdLevel Level>
+static void BM_PartitionIds(benchmark::State &state)
+{
+    SimdScope simd(state, Level);
+    if (!simd.ok())
+        return;
+    const uint32_t bits = static_cast<uint32_t>(state.range(0));
+    const AlignedArray<Tuple> &input = input_of(state.range(1));
+    alignas(64) uint32_t ids[HASH_BATCH];
+    for (auto _ : state)
+    {
+        for (size_t base = 0; base < input.size(); base += HASH_BATCH)
+        {
+            partition_ids(input.get() + base, std::min(HASH_BATCH, input.size() - base), bits, HashFn{}, ids);
+            benchmark::ClobberMemory();
+        }
+    }
+    report_tuples(state, input.size());
+}
+
+// Range ids through a splitter tree sampled from the input, batched like BM_PartitionIds
+template <SimdLevel Level>
+static void BM_RangeIds(benchmark::State &state)
+{
+    SimdScope simd(state, Level);
+    if (!simd.ok())
+        return;
+    const uint32_t bits = static_cast<uint32_t>(state.range(0));
+    const AlignedArray<Tuple> &input = input_of(state.range(1));
+    const SplitterTree tree = build_splitter_tree(input.get(), input.size(), bits);
+    alignas(64) uint32_t ids[HASH_BATCH];
+    for (auto _ : state)
+    {
+        for (size_t base = 0; base < input.size(); base += HASH_BATCH)
+        {
+            partition_ids(input.get() + base, std::min(HASH_BATCH, input.size() - base), bits, RangeHash{&tree}, ids);
+            benchmark::ClobberMemory();
+        }
+    }
+    report_tuples(state, input.size());
+}
+
+template <typename HashFn, SimdLevel Level>
+static void BM_Histogram(benchmark::State &state)
+{
+    SimdScope simd(state, Level);
+    if (!simd.ok())
+        return;
+    const uint32_t bits = static_cast<uint32_t>(state.range(0));
+    const AlignedArray<Tuple> &input = input_of(state.range(1));
+    std::vector<uint64_t> hist(size_t{1} << bits);
+    for (auto _ : state)
+    {
+        std::fill(hist.begin(), hist.end(), 0);
+        histogram<HashFn>(input.get(), input.size(), bits, hist.data());
+        benchmark::DoNotOptimize(hist.data());
+    }
+    report_tuples(state, input.size());
+}
+
+/* Destinations for a scatter of `input`: partition p starts at starts[p] in `out`.
+   Starts are rounded up to whole cache lines, as write-combined scatters need.
+*/
+template <typename HashFn>
+struct ScatterTarget
+{
+    std::vector<uint64_t> starts;
+    std::vector<uint64_t> cursors;
+    AlignedArray<Tuple> out;
+
+    ScatterTarget(const AlignedArray<Tuple> &input, uint32_t bits)
+    {
+        constexpr uint32_t line_tuples = WriteCombiner<Tuple>::TUPLES_PER_LINE;
+        std::vector<uint64_t> hist(size_t{1} << bits, 0);
+        histogram<HashFn>(input.get(), input.size(), bits, hist.data());
+        uint64_t offset = 0;
+        for (uint64_t count : hist)
+        {
+            starts.push_back(offset);
+            offset += (count + line_tuples - 1) / line_tuples * line_tuples;
+        }
+        cursors = starts;
+        out = AlignedArray<Tuple>(std::max<uint64_t>(offset, 1), CACHE_LINE_SIZE);
+        out.prefault();
+    }
+};
+
+/* Scatter with one store per tuple through private cursors (count-then-move's pass 2);
+   resetting the 2^bits cursors is part of every iteration, as it is of every real pass
+*/
+template <typename HashFn, SimdLevel Level>
+static void BM_ScatterDirect(benchmark::State &state)
+{
+    SimdScope simd(state, Level);
+    if (!simd.ok())
+        return;
+    const uint32_t bits = static_cast<uint32_t>(state.range(0));
+    const AlignedArray<Tuple> &input = input_of(state.range(1));
+    ScatterTarget<HashFn> target(input, bits);
+    for (auto _ : state)
+    {
+        std::copy(target.starts.begin(), target.starts.end(), target.cursors.begin());
+        Tuple *out = target.out.get();
+        uint64_t *cursors = target.cursors.data();
+        scatter_direct<HashFn>(input.get(), input.size(), bits, [out, cursors](uint32_t p, uint32_t)
+                               { return out + cursors[p]++; });
+        benchmark::ClobberMemory();
+    }
+    report_tuples(state, input.size());
+}
+
+// Software write-combined scatter: full lines streamed, partial lines drained at the end
+template <typename HashFn, SimdLevel Level>
+static void BM_ScatterWriteCombined(benchmark::State &state)
+{
+    SimdScope simd(state, Level);
+    if (!simd.ok())
+        return;
+    const uint32_t bits = static_cast<uint32_t>(state.range(0));
+    const AlignedArray<Tuple> &input = input_of(state.range(1));
+    ScatterTarget<HashFn> target(input, bits);
+    WriteCombiner<Tuple> wc(1u << bits, detect_stream_kernel().stream_line);
+    for (auto _ : state)
+    {
+        std::copy(target.starts.begin(), target.starts.end(), target.cursors.begin());
+        Tuple *out = target.out.get();
+        uint64_t *cursors = target.cursors.data();
+        auto reserve = [out, cursors](uint32_t p, uint32_t k)
+        {
+            Tuple *dst = out + cursors[p];
+            cursors[p] += k;
+            return dst;
+        };
+        scatter_write_combined<HashFn>(input.get(), input.size(), bits, wc, reserve);
+        drain_write_combined(wc, reserve);
+        benchmark::ClobberMemory();
+    }
+    report_tuples(state, input.size());
+}
+
+static void fanout_and_size(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"bits", "bytes"})->ArgsProduct({FANOUT_BITS, INPUT_BYTES})->Unit(benchmark::kMicrosecond);
+}
+
+BENCHMARK(BM_Hash<MaskHash>)->Apply(fanout_and_size);
+BENCHMARK(BM_Hash<MultiplicativeHash>)->Apply(fanout_and_size);
+
+#define BENCHMARK_LEVELS(kernel, hash)                                           \
+    BENCHMARK(kernel<hash, SimdLevel::Scalar>)->Apply(fanout_and_size);          \
+    BENCHMARK(kernel<hash, SimdLevel::Avx2>)->Apply(fanout_and_size);            \
+    BENCHMARK(kernel<hash, SimdLevel::Avx512>)->Apply(fanout_and_size)
+
+BENCHMARK_LEVELS(BM_PartitionIds, MaskHash);
+BENCHMARK_LEVELS(BM_PartitionIds, MultiplicativeHash);
+BENCHMARK(BM_RangeIds<SimdLevel::Scalar>)->Apply(fanout_and_size);
+BENCHMARK(BM_RangeIds<SimdLevel::Avx2>)->Apply(fanout_and_size);
+BENCHMARK(BM_RangeIds<SimdLevel::Avx512>)->Apply(fanout_and_size);
+BENCHMARK_LEVELS(BM_Histogram, MaskHash);
+BENCHMARK_LEVELS(BM_Histogram, MultiplicativeHash);
+BENCHMARK_LEVELS(BM_ScatterDirect, MaskHash);
+BENCHMARK_LEVELS(BM_ScatterDirect, MultiplicativeHash);
+BENCHMARK_LEVELS(BM_ScatterWriteCombined, MaskHash);
+BENCHMARK_LEVELS(BM_ScatterWriteCombined, MultiplicativeHash);
+
+BENCHMARK_MAIN();
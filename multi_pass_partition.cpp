@@ -0,0 +1,37 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "partition/benchmark.h"
+
+int main(int argc, char *argv[])
+{
+    // Optional argument: maximum radix bits (log2 fan-out) per pass
+    PartitionOptions opts;
+    if (argc > 1)
+        opts.max_bits_per_pass = std::stoi(argv[1]);
+    if (opts.max_bits_per_pass == 0 || opts.max_bits_per_pass > 16)
+    {
+        std::cerr << "Usage: " << argv[0] << " [max_bits_per_pass (1-16)]\n";
+        return 1;
+    }
+
+    std::vector<uint32_t> thread_counts = {1, 2, 4, 8, 16, 32};
+    std::vector<uint32_t> hash_bits = {4, 6, 8, 10, 12, 14, 16, 18, 20, 22};
+
+    for (auto threads : thread_counts)
+    {
+        for (auto b : hash_bits)
+        {
+            std::vector<double> results = measure_throughput<MultiPass>(threads, b, NUM_REPEATS, opts);
+            if (results.size() != NUM_REPEATS)
+                continue;
+            std::cout << "Threads: " << threads
+                      << ", Hash Bits: " << b
+                      << ", Throughput: " << average(results) << " MTuple/s"
+                      << ", Passes: " << describe_plan(plan_passes(b, opts.max_bits_per_pass)) << "\n";
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <pthread.h>
+
+// Map the calling thread to a single PU
+inline void pin_current_thread(int core_id)
+{
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core_id, &cpuset);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+    if (rc != 0)
+    {
+        std::cerr << "Error calling pthread_setaffinity_np: " << rc << "\n";
+    }
+}
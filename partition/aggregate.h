@@ -0,0 +1,301 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "auto_select.h"
+#include "input.h"
+#include "partition.h"
+#include "tuple.h"
+#include "workers.h"
+
+/* Parallel group-by: COUNT, SUM, MIN and MAX of the payload word grouped by key.
+   - Local:       every worker pre-aggregates its input chunk into a private table, then the
+                  tables are merged. Cheap while the groups fit in cache, so for few groups.
+   - Partitioned: the input is partitioned by key with a strategy (concurrent or independent
+                  output), then each partition is aggregated alone, its groups in cache.
+                  Partitions are popped from a work-stealing queue.
+   - Adaptive:    every worker first pre-aggregates a sample of its chunk. The number of groups
+                  is estimated from the distinct keys of the samples: if the groups fit in half
+                  the L2 cache the workers go on locally, otherwise everything is partitioned.
+   Skew keeps hot keys in few groups, so it favours the local tables.
+*/
+
+enum class AggregationMode
+{
+    Adaptive,
+    Local,
+    Partitioned
+};
+
+inline const char *aggregation_mode_name(AggregationMode mode)
+{
+    switch (mode)
+    {
+    case AggregationMode::Local:
+        return "local";
+    case AggregationMode::Partitioned:
+        return "partitioned";
+    default:
+        return "adaptive";
+    }
+}
+
+// "adaptive", "local" or "partitioned"; returns false for anything else
+inline bool parse_aggregation_mode(const std::string &s, AggregationMode &mode)
+{
+    if (s == "adaptive")
+        mode = AggregationMode::Adaptive;
+    else if (s == "local")
+        mode = AggregationMode::Local;
+    else if (s == "partitioned")
+        mode = AggregationMode::Partitioned;
+    else
+        return false;
+    return true;
+}
+
+// Aggregates of one group; count == 0 marks an empty slot
+struct Aggregate
+{
+    uint64_t key = 0;
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t min = 0;
+    uint64_t max = 0;
+};
+
+/* Linear-probing table of groups, doubling once half full. Slots are found from the high bits
+   of key * SPLITMIX_GAMMA, so keys sharing their low bits (one partition of MaskHash) spread.
+*/
+class AggregateTable
+{
+public:
+    void reset(size_t expected_groups)
+    {
+        bits_ = std::max<uint32_t>(4, std::bit_width(std::bit_ceil(std::max<size_t>(2 * expected_groups, 1))) - 1);
+        slots_.assign(size_t(1) << bits_, Aggregate{});
+        groups_ = 0;
+    }
+
+    void add(uint64_t key, uint64_t value) { add(Aggregate{key, 1, value, value, value}); }
+
+    // Fold the aggregates `a` of a group in
+    void add(const Aggregate &a)
+    {
+        Aggregate &slot = find(a.key);
+        if (slot.count == 0)
+        {
+            slot = a;
+            if (++groups_ * 2 > slots_.size())
+                grow();
+            return;
+        }
+        slot.count += a.count;
+        slot.sum += a.sum;
+        slot.min = std::min(slot.min, a.min);
+        slot.max = std::max(slot.max, a.max);
+    }
+
+    size_t groups() const { return groups_; }
+
+    template <typename F>
+    void for_each(F &&f) const
+    {
+        for (const Aggregate &a : slots_)
+        {
+            if (a.count != 0)
+                f(a);
+        }
+    }
+
+private:
+    Aggregate &find(uint64_t key)
+    {
+        const size_t mask = slots_.size() - 1;
+        for (size_t i = (key * SPLITMIX_GAMMA) >> (64 - bits_);; i = (i + 1) & mask)
+        {
+            if (slots_[i].count == 0 || slots_[i].key == key)
+                return slots_[i];
+        }
+    }
+
+    void grow()
+    {
+        std::vector<Aggregate> old(size_t(2) << bits_);
+        old.swap(slots_);
+        ++bits_;
+        for (const Aggregate &a : old)
+        {
+            if (a.count != 0)
+                find(a.key) = a;
+        }
+    }
+
+    std::vector<Aggregate> slots_;
+    uint32_t bits_ = 0;
+    size_t groups_ = 0;
+};
+
+constexpr size_t AGGREGATE_SAMPLE = 1 << 14;   // tuples per worker sampled by the adaptive mode
+constexpr uint32_t AGGREGATE_MAX_BITS = 14;   // single-pass partitioning fan-out
+
+// Groups whose tables (at most half full) fit in half the L2 cache
+inline size_t cache_resident_groups()
+{
+    const size_t l2 = cache_bytes(2) ? cache_bytes(2) : 256 << 10;
+    return l2 / 2 / (2 * sizeof(Aggregate));
+}
+
+/* Number of groups G for which `sampled` uniform draws are expected to hit `distinct` of them,
+   d = G (1 - e^(-s / G)); `limit` when every draw was distinct
+*/
+inline double estimate_groups(size_t sampled, size_t distinct, double limit)
+{
+    if (distinct >= sampled)
+        return limit;
+    double low = static_cast<double>(distinct), high = limit;
+    for (int i = 0; i < 64; ++i)
+    {
+        double g = (low + high) / 2;
+        if (g * -std::expm1(-static_cast<double>(sampled) / g) < distinct)
+            low = g;
+        else
+            high = g;
+    }
+    return high;
+}
+
+template <typename Strategy, typename TupleT = Tuple>
+struct AggregationResult
+{
+    PartitionResult<typename Strategy::template Output<TupleT>> partitions; // partitioned mode
+    std::vector<AggregateTable> locals; // one per worker
+    std::vector<AggregateTable> tables; // the groups: one table (local) or one per partition
+    StealingQueue queue;
+    size_t tuples = 0;
+    double estimated_groups = 0.0; // adaptive mode
+    bool partitioned = false;
+    uint32_t bits = 0;             // partitioned mode
+    double seconds = 0.0;          // timed regions of every phase
+    bool ok = false;
+
+    size_t groups() const
+    {
+        size_t total = 0;
+        for (const AggregateTable &table : tables)
+            total += table.groups();
+        return total;
+    }
+
+    template <typename F>
+    void for_each_group(F &&f) const
+    {
+        for (const AggregateTable &table : tables)
+            table.for_each(f);
+    }
+
+    double throughput() const { return tuples / (seconds * 1e6); } // MTuple/sec
+};
+
+/* Group `input` by key with the workers of `pool` into `result`, reusing its tables and
+   partition buffers. Strategy partitions in the partitioned mode (ConcurrentOutput or
+   IndependentOutput, whose scatter is a single pass); HashFn picks the partitions.
+*/
+template <typename Strategy, typename HashFn = MaskHash, typename TupleT = Tuple>
+bool aggregate_into(AggregationResult<Strategy, TupleT> &result, const TupleT *input, size_t n, WorkerPool &pool,
+                    const PartitionOptions &opts = {}, AggregationMode mode = AggregationMode::Adaptive, HashFn hash = {})
+{
+    const uint32_t threads = pool.size();
+    const size_t resident = cache_resident_groups();
+    SenseBarrier &sync_point = pool.barrier();
+    result.tuples = n;
+    result.seconds = 0.0;
+    result.locals.resize(threads);
+    result.partitioned = mode == AggregationMode::Partitioned;
+    double estimated_groups = static_cast<double>(n);
+
+    if (mode != AggregationMode::Partitioned)
+    {
+        // Samples first (adaptive), the rest of each chunk if the groups fit, then the merge
+        std::vector<size_t> distinct(threads, 0), sampled(threads, 0);
+        result.seconds += pool.run([&](uint32_t t)
+                                   {
+            size_t offset, count;
+            static_chunk(n, threads, t, offset, count);
+            AggregateTable& local = result.locals[t];
+            local.reset(mode == AggregationMode::Adaptive ? std::min(count, AGGREGATE_SAMPLE) : resident);
+            size_t i = 0;
+            if (mode == AggregationMode::Adaptive) {
+                for (; i < std::min(count, AGGREGATE_SAMPLE); ++i)
+                    local.add(input[offset + i].key, payload_word(input[offset + i]));
+                sampled[t] = i;
+                distinct[t] = local.groups();
+                sync_point.arrive_and_wait();
+                if (t == 0) {
+                    // Every worker samples the same key distribution: the largest estimate wins
+                    estimated_groups = 0.0;
+                    for (uint32_t u = 0; u < threads; ++u)
+                        if (sampled[u] != 0)
+                            estimated_groups = std::max(estimated_groups, estimate_groups(sampled[u], distinct[u], n));
+                    result.partitioned = estimated_groups > resident;
+                }
+                sync_point.arrive_and_wait();
+                if (result.partitioned)
+                    return;
+            }
+            for (; i < count; ++i)
+                local.add(input[offset + i].key, payload_word(input[offset + i]));
+            sync_point.arrive_and_wait();
+            // Few groups by now: one worker merges the tables
+            if (t == 0) {
+                size_t groups = 0;
+                for (const AggregateTable& table : result.locals)
+                    groups = std::max(groups, table.groups());
+                result.tables.resize(1);
+                result.tables[0].reset(groups);
+                for (const AggregateTable& table : result.locals)
+                    table.for_each([&](const Aggregate& a) { result.tables[0].add(a); });
+            } });
+        result.estimated_groups = mode == AggregationMode::Adaptive ? estimated_groups : 0.0;
+        if (!result.partitioned)
+        {
+            result.bits = 0;
+            result.ok = true;
+            return true;
+        }
+    }
+
+    // Enough partitions for the groups of one to fit in cache
+    uint32_t bits = 1;
+    while (bits < AGGREGATE_MAX_BITS && estimated_groups / (size_t(1) << bits) > resident)
+        ++bits;
+    result.bits = bits;
+    result.ok = partition_into<Strategy, HashFn>(result.partitions, input, n, bits, pool, opts, hash);
+    if (!result.ok)
+        return false;
+    result.seconds += result.partitions.seconds;
+
+    const auto &out = result.partitions.output;
+    const uint32_t num_partitions = out.num_partitions();
+    result.tables.resize(num_partitions);
+    result.queue.reset(num_partitions, threads);
+    result.seconds += pool.run([&](uint32_t t)
+                               {
+        uint32_t p;
+        while (result.queue.pop(t, p)) {
+            AggregateTable& table = result.tables[p];
+            table.reset(std::min<double>(out.size(p), estimated_groups / num_partitions));
+            out.for_each_run(p, [&](const TupleT* data, size_t count) {
+                for (size_t i = 0; i < count; ++i)
+                    table.add(data[i].key, payload_word(data[i]));
+            });
+        } });
+    return true;
+}
@@ -0,0 +1,570 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "input.h"
+#include "partition.h"
+#include "topology.h"
+
+/* Automatic choice of strategy, number of passes and thread count for a request of n tuples,
+   b bits and up to T threads. The machine is calibrated once per process, in about a second:
+   cache sizes come from sysfs; load latency over growing working sets (which also gives the
+   TLB reach), atomic latency with and without contention, copy bandwidth, barrier costs and
+   one thread's histogram and scatter cost per fan-out are measured. A cost model turns them
+   into a predicted time per strategy, and the cheapest feasible one wins.
+
+   Each phase of a worker costs, per tuple, the larger of its compute and its share of the
+   memory bandwidth. Compute is the measured kernel cost at the phase's fan-out, plus the
+   misses of sharing the last level cache with the other workers and any atomics; phases add
+   their barriers and per-partition bookkeeping.
+*/
+
+// Name that asks the benchmark driver for the strategy the cost model picks
+constexpr const char *AUTO_STRATEGY = "auto";
+
+constexpr uint32_t LATENCY_MIN_LOG2 = 4; // latency curves start at 16 lines or pages
+constexpr uint32_t KERNEL_BITS_STEP = 2; // kernel curves are sampled at 2, 4, ..., 20 bits
+constexpr uint32_t KERNEL_MAX_BITS = 20;
+
+struct MachineProfile
+{
+    uint32_t hardware_threads = 1;
+    size_t l1d_bytes = 32 << 10;
+    size_t l2_bytes = 1 << 20;
+    size_t llc_bytes = 32 << 20;
+    // Latency of dependent random loads over 2^(LATENCY_MIN_LOG2 + i) cache lines, and the
+    // extra latency when as many loads are spread over as many 4KB pages (both non-decreasing)
+    std::vector<double> line_ns;
+    std::vector<double> page_ns;
+    uint32_t tlb_entries = 1024;         // pages reachable before page_ns reaches half its maximum
+    double tlb_miss_ns = 10.0;           // maximum of page_ns
+    double l2_ns = 4.0;                  // line_ns halfway into L2
+    double llc_ns = 20.0;                // ... halfway into the last level cache
+    double dram_ns = 90.0;               // ... at the end of the curve
+    double atomic_ns = 5.0;              // fetch_add on a private cache line
+    double contended_atomic_ns = 50.0;   // fetch_add on one line shared by all hardware threads
+    double bandwidth_gbps = 20.0;        // copy bandwidth (read + write) of all hardware threads
+    double thread_bandwidth_gbps = 10.0; // same, one thread
+    // One thread's direct scatter and histogram, ns per tuple at KERNEL_BITS_STEP * (i + 1) bits
+    std::vector<double> scatter_ns;
+    std::vector<double> histogram_ns;
+    double tuple_ns = 1.0;               // hash and store of one tuple, all in L1
+    double miss_overlap = 4.0;           // store misses in flight at once
+    double barrier_seconds = 1e-6;       // one barrier of all hardware threads
+    double dispatch_seconds = 1e-5;      // waking the pool and its start and end barriers
+    double calibration_seconds = 0.0;
+};
+
+// Size of the data or unified cache of the given level of CPU 0 (sysfs), or 0 if unknown
+inline size_t cache_bytes(int level)
+{
+    const std::string dir = "/sys/devices/system/cpu/cpu0/cache/index";
+    for (int index = 0;; ++index)
+    {
+        const std::string prefix = dir + std::to_string(index);
+        std::string level_text = read_sysfs(prefix + "/level");
+        if (level_text.empty())
+            return 0;
+        if (std::stoi(level_text) != level || read_sysfs(prefix + "/type") == "Instruction")
+            continue;
+        std::string size = read_sysfs(prefix + "/size");
+        if (size.empty() || !std::isdigit(static_cast<unsigned char>(size[0])))
+            return 0;
+        size_t bytes = std::stoull(size);
+        if (size.back() == 'K')
+            bytes <<= 10;
+        else if (size.back() == 'M')
+            bytes <<= 20;
+        else if (size.back() == 'G')
+            bytes <<= 30;
+        return bytes;
+    }
+}
+
+/* Latency (ns per load) of dependent loads cycling in random order through `slots` slots
+   `stride` bytes apart, on 4KB pages. Slots in consecutive strides use different lines of
+   their page, so a page stride measures the TLB rather than the L1's associativity.
+*/
+inline double chase_latency_ns(size_t slots, size_t stride, size_t loads)
+{
+    const size_t bytes = (slots * stride + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    AlignedArray<char> memory(bytes);
+    madvise(memory.get(), bytes, MADV_NOHUGEPAGE);
+    const size_t lines_per_stride = std::max<size_t>(1, stride / CACHE_LINE_SIZE);
+    auto slot = [&](size_t i)
+    { return reinterpret_cast<uintptr_t *>(memory.get() + i * stride + i % lines_per_stride * CACHE_LINE_SIZE); };
+
+    // Sattolo's shuffle: i -> next[i] is a single cycle through all slots
+    std::vector<uint32_t> next(slots);
+    for (size_t i = 0; i < slots; ++i)
+        next[i] = static_cast<uint32_t>(i);
+    std::mt19937_64 rng(42);
+    for (size_t i = slots - 1; i > 0; --i)
+        std::swap(next[i], next[rng() % i]);
+    for (size_t i = 0; i < slots; ++i)
+        *slot(i) = reinterpret_cast<uintptr_t>(slot(next[i]));
+
+    uintptr_t p = reinterpret_cast<uintptr_t>(slot(0));
+    if (slots <= loads)
+        for (size_t i = 0; i < slots; ++i)
+            p = *reinterpret_cast<uintptr_t *>(p);
+    auto begin = WorkerClock::now();
+    for (size_t i = 0; i < loads; ++i)
+        p = *reinterpret_cast<uintptr_t *>(p);
+    auto end = WorkerClock::now();
+    asm volatile("" : : "r"(p));
+    return std::chrono::duration<double, std::nano>(end - begin).count() / loads;
+}
+
+/* A curve sampled at x = first, first + step, ... at `x`, interpolated linearly and clamped
+   to its ends (x is a log2: lines, pages or bits)
+*/
+inline double curve_at(const std::vector<double> &curve, double x, double first, double step = 1.0)
+{
+    if (curve.empty())
+        return 0.0;
+    const double pos = (x - first) / step;
+    if (pos <= 0.0)
+        return curve.front();
+    if (pos >= curve.size() - 1)
+        return curve.back();
+    const size_t i = static_cast<size_t>(pos);
+    return curve[i] + (curve[i + 1] - curve[i]) * (pos - i);
+}
+
+/* Extra time per tuple of writing to `lines` active cache lines spread over `pages` pages,
+   by `threads` workers: the load latency over that working set beyond an L1-sized one,
+   divided by the misses a core keeps in flight. Beyond L2 the workers' lines add up in the
+   shared cache.
+*/
+inline double miss_ns(const MachineProfile &m, double lines, double pages, uint32_t threads)
+{
+    if (lines * CACHE_LINE_SIZE > m.l2_bytes)
+        lines *= threads;
+    auto latency = [&m](double lines)
+    { return curve_at(m.line_ns, std::log2(std::max(lines, 1.0)), LATENCY_MIN_LOG2); };
+    return (latency(lines) - latency(1.0) + curve_at(m.page_ns, std::log2(std::max(pages, 1.0)), LATENCY_MIN_LOG2)) /
+           m.miss_overlap;
+}
+
+/* Compute per tuple of one of `threads` workers scattering into 2^bits partitions (one
+   active line on its own page each), or counting them in 8-byte counters: one thread's
+   measured cost plus the misses the other workers add in the shared cache
+*/
+inline double scatter_kernel_ns(const MachineProfile &m, uint32_t bits, uint32_t threads)
+{
+    const double f = static_cast<double>(1ull << bits);
+    return curve_at(m.scatter_ns, bits, KERNEL_BITS_STEP, KERNEL_BITS_STEP) + miss_ns(m, f, f, threads) - miss_ns(m, f, f, 1);
+}
+
+inline double histogram_kernel_ns(const MachineProfile &m, uint32_t bits, uint32_t threads)
+{
+    const double lines = static_cast<double>(1ull << bits) * sizeof(uint64_t) / CACHE_LINE_SIZE;
+    const double pages = lines * CACHE_LINE_SIZE / PAGE_SIZE;
+    return curve_at(m.histogram_ns, bits, KERNEL_BITS_STEP, KERNEL_BITS_STEP) + miss_ns(m, lines, pages, threads) -
+           miss_ns(m, lines, pages, 1);
+}
+
+/* Measure the machine with the workers of `pool` (one per hardware thread for a full profile).
+   Needs up to about 300MB of memory for the latency and bandwidth probes.
+*/
+inline MachineProfile calibrate_machine(WorkerPool &pool)
+{
+    auto started = WorkerClock::now();
+    MachineProfile m;
+    const uint32_t threads = pool.size();
+    m.hardware_threads = threads;
+    m.l1d_bytes = cache_bytes(1) ? cache_bytes(1) : m.l1d_bytes;
+    m.l2_bytes = cache_bytes(2) ? cache_bytes(2) : m.l2_bytes;
+    const size_t l3_bytes = cache_bytes(3);
+    m.llc_bytes = l3_bytes ? l3_bytes : cache_bytes(2) ? m.l2_bytes : m.llc_bytes; // no L3: L2 is the LLC
+
+    // Latency curves: random loads over 2^k lines up to twice the LLC (at most 64MB), and over
+    // 2^k pages against as many lines packed into few pages. The TLB reach is the largest page
+    // count before the page penalty climbs to half its maximum.
+    constexpr size_t LOADS = 1 << 17;
+    constexpr uint32_t MAX_PAGES_LOG2 = 14;
+    const size_t far_lines = std::min<size_t>(2 * m.llc_bytes, 64 << 20) / CACHE_LINE_SIZE;
+    for (size_t lines = size_t(1) << LATENCY_MIN_LOG2; lines <= far_lines; lines *= 2)
+        m.line_ns.push_back(std::max(m.line_ns.empty() ? 0.0 : m.line_ns.back(), chase_latency_ns(lines, CACHE_LINE_SIZE, LOADS)));
+    for (uint32_t k = LATENCY_MIN_LOG2; k <= MAX_PAGES_LOG2; ++k)
+    {
+        const size_t pages = size_t(1) << k;
+        const double penalty = chase_latency_ns(pages, PAGE_SIZE, LOADS) - chase_latency_ns(pages, CACHE_LINE_SIZE, LOADS);
+        m.page_ns.push_back(std::max(m.page_ns.empty() ? 0.0 : m.page_ns.back(), penalty));
+    }
+    m.tlb_miss_ns = m.page_ns.back();
+    m.tlb_entries = 1u << MAX_PAGES_LOG2;
+    for (uint32_t i = 0; i < m.page_ns.size() && m.tlb_miss_ns > 0.5; ++i)
+        if (m.page_ns[i] >= m.tlb_miss_ns / 2)
+        {
+            m.tlb_entries = 1u << (LATENCY_MIN_LOG2 + std::max(i, 1u) - 1);
+            break;
+        }
+    auto latency_at = [&m](size_t bytes)
+    { return curve_at(m.line_ns, std::log2(static_cast<double>(bytes / CACHE_LINE_SIZE)), LATENCY_MIN_LOG2); };
+    m.l2_ns = latency_at(m.l2_bytes / 2);
+    m.llc_ns = latency_at(m.llc_bytes / 2);
+    m.dram_ns = m.line_ns.back();
+
+    // Atomics: every worker on its own line, then all on one line
+    constexpr uint32_t OPS = 1 << 18;
+    struct alignas(64) Counter
+    {
+        std::atomic<uint64_t> value{0};
+    };
+    std::vector<Counter> counters(threads + 1);
+    double seconds = pool.run([&](uint32_t t)
+                              { for (uint32_t i = 0; i < OPS; ++i) counters[t].value.fetch_add(1, std::memory_order_relaxed); });
+    m.atomic_ns = seconds * 1e9 / OPS;
+    seconds = pool.run([&](uint32_t)
+                       { for (uint32_t i = 0; i < OPS; ++i) counters[threads].value.fetch_add(1, std::memory_order_relaxed); });
+    m.contended_atomic_ns = std::max(m.atomic_ns, seconds * 1e9 / OPS);
+
+    // Copy bandwidth, all workers then worker 0 alone (buffers faulted in first)
+    {
+        const size_t bytes = std::min<size_t>(std::max<size_t>(2 * m.llc_bytes, 64 << 20), 128 << 20);
+        AlignedArray<char> src(bytes), dst(bytes);
+        auto copy = [&](uint32_t t, uint32_t workers, bool fill)
+        {
+            if (t >= workers)
+                return;
+            size_t offset, count;
+            static_chunk(bytes, workers, t, offset, count);
+            if (fill)
+            {
+                std::memset(src.get() + offset, 1, count);
+                std::memset(dst.get() + offset, 0, count);
+            }
+            else
+                std::memcpy(dst.get() + offset, src.get() + offset, count);
+        };
+        pool.run([&](uint32_t t)
+                 { copy(t, threads, true); });
+        seconds = pool.run([&](uint32_t t)
+                           { copy(t, threads, false); });
+        m.bandwidth_gbps = 2.0 * bytes / seconds / 1e9;
+        seconds = pool.run([&](uint32_t t)
+                           { copy(t, 1, false); });
+        m.thread_bandwidth_gbps = std::min(m.bandwidth_gbps * threads, 2.0 * bytes / seconds / 1e9);
+        m.bandwidth_gbps = std::max(m.bandwidth_gbps, m.thread_bandwidth_gbps);
+    }
+
+    // Per-tuple compute: best of repeated direct scatters of an L1-sized input into 16 partitions
+    {
+        constexpr size_t TUPLES = 1024;
+        constexpr uint32_t BITS = 4;
+        AlignedArray<Tuple> in(TUPLES, CACHE_LINE_SIZE), out(TUPLES, CACHE_LINE_SIZE);
+        generate_input(in.get(), TUPLES);
+        uint64_t starts[1u << BITS] = {}, cursors[1u << BITS];
+        histogram<MaskHash>(in.get(), TUPLES, BITS, starts);
+        for (uint64_t p = 0, sum = 0; p < (1u << BITS); ++p)
+            sum += std::exchange(starts[p], sum);
+        double best = 1e9;
+        for (int r = 0; r < 256; ++r)
+        {
+            std::copy(starts, starts + (1u << BITS), cursors);
+            auto begin = WorkerClock::now();
+            scatter_direct<MaskHash>(in.get(), TUPLES, BITS, [&](uint32_t p, uint32_t)
+                                     { return out.get() + cursors[p]++; });
+            best = std::min(best, std::chrono::duration<double, std::nano>(WorkerClock::now() - begin).count());
+        }
+        m.tuple_ns = best / TUPLES;
+    }
+
+    // Kernel curves: one thread's histogram and direct scatter of a 16MB input at every
+    // sampled fan-out. They include what latency sums cannot predict: prefetching, store
+    // buffer and write-allocate behavior, and page walks of many output streams.
+    {
+        constexpr size_t TUPLES = 1 << 20;
+        AlignedArray<Tuple> in(TUPLES, CACHE_LINE_SIZE), out(TUPLES, CACHE_LINE_SIZE);
+        generate_input(in.get(), TUPLES);
+        out.prefault();
+        auto ns_per_tuple = [](WorkerClock::time_point begin)
+        { return std::chrono::duration<double, std::nano>(WorkerClock::now() - begin).count() / TUPLES; };
+        for (uint32_t bits = KERNEL_BITS_STEP; bits <= KERNEL_MAX_BITS; bits += KERNEL_BITS_STEP)
+        {
+            std::vector<uint64_t> cursors(size_t(1) << bits, 0);
+            auto begin = WorkerClock::now();
+            histogram<MaskHash>(in.get(), TUPLES, bits, cursors.data());
+            m.histogram_ns.push_back(ns_per_tuple(begin));
+            for (uint64_t p = 0, sum = 0; p < cursors.size(); ++p)
+                sum += std::exchange(cursors[p], sum);
+            begin = WorkerClock::now();
+            scatter_direct<MaskHash>(in.get(), TUPLES, bits, [&](uint32_t p, uint32_t)
+                                     { return out.get() + cursors[p]++; });
+            m.scatter_ns.push_back(ns_per_tuple(begin));
+        }
+    }
+
+    // How far store misses overlap: the latency sum of a 2^14-way scatter's misses against
+    // the cost it shows over a 2^4-way one
+    {
+        m.miss_overlap = 1.0;
+        const double latency_sum = miss_ns(m, 1 << 14, 1 << 14, 1) - miss_ns(m, 1 << 4, 1 << 4, 1);
+        const double shown = curve_at(m.scatter_ns, 14, KERNEL_BITS_STEP, KERNEL_BITS_STEP) -
+                             curve_at(m.scatter_ns, 4, KERNEL_BITS_STEP, KERNEL_BITS_STEP);
+        m.miss_overlap = shown > latency_sum / 16 ? std::clamp(latency_sum / shown, 1.0, 16.0) : 16.0;
+    }
+
+    // Barriers and waking the pool
+    constexpr int BARRIERS = 64;
+    SenseBarrier &barrier = pool.barrier();
+    m.barrier_seconds = pool.run([&](uint32_t)
+                                 { for (int i = 0; i < BARRIERS; ++i) barrier.arrive_and_wait(); }) /
+                        BARRIERS;
+    std::vector<double> dispatch;
+    for (int i = 0; i < 16; ++i)
+    {
+        pool.run([](uint32_t) {});
+        const WorkerRun &run = pool.last_run();
+        dispatch.push_back(std::chrono::duration<double>(run.returned - run.dispatched).count());
+    }
+    std::nth_element(dispatch.begin(), dispatch.begin() + dispatch.size() / 2, dispatch.end());
+    m.dispatch_seconds = dispatch[dispatch.size() / 2];
+
+    m.calibration_seconds = std::chrono::duration<double>(WorkerClock::now() - started).count();
+    return m;
+}
+
+inline std::string describe_profile(const MachineProfile &m)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1) << m.hardware_threads << " threads, L1d " << (m.l1d_bytes >> 10)
+        << "KB, L2 " << (m.l2_bytes >> 10) << "KB, LLC " << (m.llc_bytes >> 20) << "MB, TLB reach " << m.tlb_entries
+        << " pages (miss " << m.tlb_miss_ns << " ns), latency L2 " << m.l2_ns << " / LLC " << m.llc_ns << " / far "
+        << m.dram_ns << " ns, atomic " << m.atomic_ns << " ns (contended " << m.contended_atomic_ns << " ns), copy "
+        << m.bandwidth_gbps << " GB/s (one thread " << m.thread_bandwidth_gbps << " GB/s), scatter";
+    for (size_t i = 0; i < m.scatter_ns.size(); i += 2)
+        out << " " << KERNEL_BITS_STEP * (i + 1) << "b:" << m.scatter_ns[i];
+    out << " ns/tuple, calibrated in " << std::setprecision(0) << m.calibration_seconds * 1e3 << " ms";
+    return out.str();
+}
+
+// Profile of this machine, calibrated on first use with one worker per hardware thread and logged to stderr
+inline const MachineProfile &machine_profile()
+{
+    static const MachineProfile profile = []
+    {
+        WorkerPool pool(std::max(1u, std::thread::hardware_concurrency()));
+        MachineProfile m = calibrate_machine(pool);
+        std::cerr << "Calibration: " << describe_profile(m) << "\n";
+        return m;
+    }();
+    return profile;
+}
+
+/* A strategy, its configuration and predicted time. `max_bits_per_pass` is the multi-pass
+   setting that yields `passes` passes (PartitionOptions::max_bits_per_pass).
+*/
+struct StrategyChoice
+{
+    std::string strategy;
+    uint32_t threads = 1;
+    uint32_t passes = 1;
+    uint32_t max_bits_per_pass = 0;
+    double seconds = 0.0; // predicted
+};
+
+inline std::string describe_choice(const StrategyChoice &choice)
+{
+    std::ostringstream out;
+    out << choice.strategy << " on " << choice.threads << (choice.threads == 1 ? " thread" : " threads");
+    if (choice.passes > 1)
+        out << ", " << choice.passes << " passes of at most " << choice.max_bits_per_pass << " bits";
+    out << std::fixed << std::setprecision(3) << " (predicted " << choice.seconds * 1e3 << " ms)";
+    return out.str();
+}
+
+// Options for running `choice`
+inline PartitionOptions apply_choice(const StrategyChoice &choice, PartitionOptions opts)
+{
+    if (choice.passes > 1)
+        opts.max_bits_per_pass = choice.max_bits_per_pass;
+    return opts;
+}
+
+/* Predicted time of one phase in which each of `threads` workers handles `tuples_per_worker`
+   tuples: compute at `compute_ns` per tuple (slowed down when workers outnumber hardware
+   threads) against moving `bytes` per tuple at the worker's share of the bandwidth.
+*/
+inline double phase_seconds(const MachineProfile &m, uint32_t threads, double tuples_per_worker, double compute_ns,
+                            double bytes)
+{
+    const double cpu_share = std::min(1.0, static_cast<double>(m.hardware_threads) / threads);
+    const double gbps = std::min(m.thread_bandwidth_gbps * cpu_share, m.bandwidth_gbps / threads);
+    return tuples_per_worker * std::max(compute_ns / cpu_share, bytes / gbps) * 1e-9;
+}
+
+// A barrier of `threads` workers, scaled from the calibrated barrier of all hardware threads
+inline double barrier_seconds(const MachineProfile &m, uint32_t threads)
+{
+    return m.barrier_seconds * std::max(1.0, static_cast<double>(threads) / m.hardware_threads);
+}
+
+// fetch_add on a line `sharers` workers update at once
+inline double atomic_ns(const MachineProfile &m, double sharers)
+{
+    if (m.hardware_threads <= 1 || sharers <= 1.0)
+        return m.atomic_ns;
+    const double share = (std::min<double>(sharers, m.hardware_threads) - 1.0) / (m.hardware_threads - 1);
+    return m.atomic_ns + (m.contended_atomic_ns - m.atomic_ns) * share;
+}
+
+/* Predicted time of `strategy` on `threads` workers; passes only matters for multi-pass.
+   Negative when the strategy cannot run the request: too many partitions for its buffers, or
+   an output footprint beyond half the physical memory.
+*/
+inline double predict_seconds(const MachineProfile &m, const std::string &strategy, uint32_t bits, size_t n,
+                              uint32_t threads, uint32_t passes, const PartitionOptions &opts,
+                              size_t tuple_bytes = sizeof(Tuple))
+{
+    const double fanout = static_cast<double>(1ull << bits);
+    const double per_worker = static_cast<double>(n) / threads;
+    const double line_tuples = std::max<double>(1.0, CACHE_LINE_SIZE / tuple_bytes);
+    const bool swwc = opts.scatter == ScatterMode::WriteCombine;
+    const bool growable = opts.buffers == BufferSizing::Growable;
+    // A scatter reads a tuple and writes it, reading the destination line first unless streamed
+    const double move = (swwc ? 2.0 : 3.0) * tuple_bytes;
+    const double scatter = scatter_kernel_ns(m, bits, threads);
+
+    double footprint = static_cast<double>(n) * tuple_bytes; // output bytes
+    double seconds = m.dispatch_seconds * std::max(1.0, static_cast<double>(threads) / m.hardware_threads);
+    if (strategy == ConcurrentOutput::name)
+    {
+        if (bits > ConcurrentOutput::MAX_BITS && !growable)
+            return -1.0;
+        // Every claim takes the partition's write index from another worker's cache; workers
+        // collide on it the more often the fewer partitions there are
+        const double claims = swwc ? 1.0 / line_tuples : 1.0;
+        const double sharers = 1.0 + (threads - 1) * std::min(1.0, threads / fanout);
+        const double transfer = threads > 1 ? m.llc_ns / m.miss_overlap : 0.0;
+        seconds += phase_seconds(m, threads, per_worker, scatter + claims * (atomic_ns(m, sharers) + transfer), move);
+        seconds += fanout * m.tuple_ns * 1e-9; // buffer layout
+        footprint = footprint * (growable ? 1.0 : 2.0) + fanout * 4 * CACHE_LINE_SIZE;
+    }
+    else if (strategy == IndependentOutput::name)
+    {
+        seconds += phase_seconds(m, threads, per_worker, scatter, move);
+        seconds += fanout * m.tuple_ns * 1e-9;
+        footprint = footprint * (growable ? 1.0 : 2.0) + threads * fanout * 4 * CACHE_LINE_SIZE;
+    }
+    else if (strategy == ParallelBuffers::name)
+    {
+        const double chunk_tuples = choose_chunk_tuples(n, threads, static_cast<uint32_t>(fanout));
+        seconds += phase_seconds(m, threads, per_worker, scatter + atomic_ns(m, threads) / chunk_tuples, move);
+        seconds += barrier_seconds(m, threads) + fanout / threads * m.l2_ns * 1e-9; // list concatenation
+        footprint += threads * fanout * chunk_tuples * tuple_bytes;
+    }
+    else if (strategy == CountThenMove::name)
+    {
+        seconds += phase_seconds(m, threads, per_worker, histogram_kernel_ns(m, bits, threads), tuple_bytes);
+        seconds += 2 * fanout * m.tuple_ns * 1e-9 + 3 * barrier_seconds(m, threads); // two prefix sum steps
+        seconds += phase_seconds(m, threads, per_worker, scatter, move);
+    }
+    else if (strategy == MultiPass::name)
+    {
+        const PassPlan plan = plan_passes(bits, (bits + passes - 1) / std::max(1u, passes));
+        if (plan.bits.size() != passes || passes < 2)
+            return -1.0;
+        // Pass 0 as count-then-move with its prefix sum on one worker; later passes split the
+        // sub-partitions of the previous pass among the workers
+        double sub_partitions = 1.0;
+        for (uint32_t j = 0; j < passes; ++j)
+        {
+            const double f = static_cast<double>(1ull << plan.bits[j]);
+            seconds += phase_seconds(m, threads, per_worker, histogram_kernel_ns(m, plan.bits[j], threads), tuple_bytes);
+            seconds += phase_seconds(m, threads, per_worker, scatter_kernel_ns(m, plan.bits[j], threads), move);
+            seconds += (j == 0 ? f * threads : sub_partitions * f / threads) * m.tuple_ns * 1e-9;
+            seconds += (j == 0 ? 3 : 1) * barrier_seconds(m, threads);
+            sub_partitions *= f;
+        }
+        footprint *= 2.0;
+    }
+    else
+        return -1.0;
+
+    const double memory = static_cast<double>(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGE_SIZE);
+    if (memory > 0 && footprint > memory / 2)
+        return -1.0;
+    return seconds;
+}
+
+// Every feasible strategy (multi-pass with 2 or 3 passes) on exactly `threads` workers, fastest first
+inline std::vector<StrategyChoice> rank_strategies(const MachineProfile &m, uint32_t bits, size_t n, uint32_t threads,
+                                                   const PartitionOptions &opts, size_t tuple_bytes = sizeof(Tuple))
+{
+    std::vector<StrategyChoice> choices;
+    auto consider = [&](const char *strategy, uint32_t passes)
+    {
+        double seconds = predict_seconds(m, strategy, bits, n, threads, passes, opts, tuple_bytes);
+        if (seconds >= 0.0)
+            choices.push_back({strategy, threads, passes, passes > 1 ? (bits + passes - 1) / passes : 0, seconds});
+    };
+    for (const char *strategy : {ConcurrentOutput::name, IndependentOutput::name, CountThenMove::name, ParallelBuffers::name})
+        consider(strategy, 1);
+    for (uint32_t passes = 2; passes <= 3 && passes <= bits; ++passes)
+        consider(MultiPass::name, passes);
+    std::stable_sort(choices.begin(), choices.end(), [](const StrategyChoice &a, const StrategyChoice &b)
+                     { return a.seconds < b.seconds; });
+    return choices;
+}
+
+// Fastest strategy on exactly `threads` workers (count-then-move if none is predicted feasible)
+inline StrategyChoice choose_strategy(const MachineProfile &m, uint32_t bits, size_t n, uint32_t threads,
+                                      const PartitionOptions &opts, size_t tuple_bytes = sizeof(Tuple))
+{
+    std::vector<StrategyChoice> choices = rank_strategies(m, bits, n, threads, opts, tuple_bytes);
+    return choices.empty() ? StrategyChoice{CountThenMove::name, threads} : choices.front();
+}
+
+// Fastest strategy and thread count up to `max_threads`
+inline StrategyChoice choose_plan(const MachineProfile &m, uint32_t bits, size_t n, uint32_t max_threads,
+                                  const PartitionOptions &opts, size_t tuple_bytes = sizeof(Tuple))
+{
+    StrategyChoice best = choose_strategy(m, bits, n, 1, opts, tuple_bytes);
+    for (uint32_t threads = 2; threads <= max_threads; ++threads)
+    {
+        StrategyChoice choice = choose_strategy(m, bits, n, threads, opts, tuple_bytes);
+        if (choice.seconds < best.seconds)
+            best = choice;
+    }
+    return best;
+}
+
+/* Partition with the strategy, passes and thread count the cost model predicts fastest on
+   this machine, on a fresh pool of that many workers, and hand the result to
+   consume(PartitionResult<Output> &). The decision is logged to stderr. False on failure.
+*/
+template <typename HashFn = MaskHash, typename TupleT = Tuple, typename Consume>
+bool partition_auto(const TupleT *input, size_t n, uint32_t bits, uint32_t max_threads, const PartitionOptions &opts,
+                    Consume &&consume)
+{
+    const StrategyChoice choice = choose_plan(machine_profile(), bits, n, std::max(1u, max_threads), opts, sizeof(TupleT));
+    std::cerr << "Auto: " << n << " tuples, " << bits << " bits, up to " << max_threads << " threads -> "
+              << describe_choice(choice) << "\n";
+    bool ok = false;
+    visit_strategy(choice.strategy, [&](auto s)
+                   {
+        auto result = partition<typename decltype(s)::type, HashFn>(input, n, bits, choice.threads, apply_choice(choice, opts));
+        ok = result.ok;
+        if (ok)
+            consume(result); });
+    return ok;
+}
@@ -0,0 +1,276 @@
+#pragma once
+
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "auto_select.h"
+#include "benchmark.h"
+#include "columnar.h"
+#include "partition.h"
+#include "range_partition.h"
+#include "topology.h"
+
+/* Configuration of the benchmark driver: which strategies, thread counts and hash bits to
+   sweep, on what input and placement, and how many warm-up and measured runs per case.
+   Every key can be set on the command line (--key=value) or in a flat JSON object
+   (--config=file.json, arrays for the list keys); later settings override earlier ones.
+*/
+struct BenchConfig
+{
+    std::vector<std::string> strategies = {ConcurrentOutput::name};
+    std::string hash = MaskHash::name;
+    std::vector<uint32_t> threads = {1};
+    std::vector<uint32_t> bits = {4, 6, 8, 10, 12, 14, 16};
+    std::vector<uint32_t> widths = {static_cast<uint32_t>(TUPLE_SIZE)}; // row bytes; columnar: the key plus width / 8 - 1 payload columns
+    size_t tuples = TUPLES_PER_EXPERIMENT;
+    std::string pinning = "none"; // pinning policy, or a comma-separated list of core ids
+    PartitionOptions opts;
+    InputSpec input;
+    int warmups = 1;
+    int repeats = NUM_REPEATS;
+    std::string format = "csv"; // "csv" or "json"
+    std::string output;         // empty: standard output
+    bool counters = false;      // per-worker perf_event counters around the measured runs
+    std::string details_output; // CSV of the per-worker, per-phase details (JSON reports embed them)
+    std::string trace;          // Chrome trace JSON of the measured runs' worker timelines
+};
+
+// Comma-separated list of unsigned 32-bit numbers, each within [min, max]
+inline bool parse_number_list(const std::string &s, std::vector<uint32_t> &values, uint32_t min = 0,
+                              uint32_t max = UINT32_MAX)
+{
+    std::vector<uint32_t> parsed;
+    std::stringstream in(s);
+    std::string item;
+    while (std::getline(in, item, ','))
+    {
+        if (item.empty() || item.find_first_not_of("0123456789") != std::string::npos)
+            return false;
+        const unsigned long long value = std::stoull(item);
+        if (value < min || value > max)
+            return false;
+        parsed.push_back(static_cast<uint32_t>(value));
+    }
+    if (parsed.empty())
+        return false;
+    values = parsed;
+    return true;
+}
+
+// Workers' cores for `threads` workers under `pinning`; false if it is neither a policy nor a core list
+inline bool resolve_pinning(const std::string &pinning, uint32_t threads, std::vector<int> &cores)
+{
+    PinningPolicy policy;
+    int node = 0;
+    if (parse_pinning_policy(pinning, policy, node))
+    {
+        cores = pin_cores(policy, threads, node);
+        return true;
+    }
+    std::vector<uint32_t> ids;
+    if (!parse_number_list(pinning, ids))
+        return false;
+    cores.assign(ids.begin(), ids.end());
+    return true;
+}
+
+// Set one key; prints what is wrong and returns false for an unknown key or a bad value
+inline bool set_bench_option(BenchConfig &config, const std::string &key, const std::string &value)
+{
+    bool ok = true;
+    try
+    {
+        if (key == "strategy" || key == "strategies")
+        {
+            std::vector<std::string> names;
+            std::stringstream in(value);
+            for (std::string name; ok && std::getline(in, name, ',');)
+            {
+                ok = name == AUTO_STRATEGY || name == ColumnarCountThenMove::name || visit_strategy(name, [](auto) {});
+                names.push_back(name);
+            }
+            ok = ok && !names.empty();
+            if (ok)
+                config.strategies = names;
+        }
+        else if (key == "hash")
+            ok = (config.hash = value) == RangeHash::name || visit_hash(value, [](auto) {});
+        else if (key == "threads")
+            ok = parse_number_list(value, config.threads, 1);
+        else if (key == "bits")
+            ok = parse_number_list(value, config.bits, 1, PARTITION_MAX_BITS);
+        else if (key == "width")
+        {
+            ok = parse_number_list(value, config.widths);
+            for (uint32_t width : config.widths)
+                ok = ok && visit_tuple_width(width, [](auto) {});
+        }
+        else if (key == "tuples")
+            ok = (config.tuples = std::stoull(value)) > 0;
+        else if (key == "pinning")
+        {
+            std::vector<int> unused;
+            ok = resolve_pinning(config.pinning = value, 1, unused);
+        }
+        else if (key == "scatter")
+            ok = parse_scatter_mode(value.c_str(), config.opts.scatter);
+        else if (key == "pages")
+            ok = parse_page_size(value, config.opts.pages);
+        else if (key == "numa")
+            ok = parse_numa_policy(value, config.opts.numa, config.opts.numa_node);
+        else if (key == "buffers")
+            ok = parse_buffer_sizing(value.c_str(), config.opts.buffers);
+        else if (key == "schedule")
+            ok = parse_schedule(value, config.opts.schedule);
+        else if (key == "morsel")
+            ok = (config.opts.morsel_tuples = std::stoull(value)) > 0;
+        else if (key == "input")
+            ok = parse_input_spec(value, config.input);
+        else if (key == "seed")
+            config.input.seed = std::stoull(value);
+        else if (key == "warmups")
+            ok = (config.warmups = std::stoi(value)) >= 0;
+        else if (key == "repeats")
+            ok = (config.repeats = std::stoi(value)) > 0;
+        else if (key == "format")
+            ok = (config.format = value) == "csv" || value == "json";
+        else if (key == "output")
+            config.output = value;
+        else if (key == "counters")
+        {
+            config.counters = value == "on" || value == "true";
+            ok = config.counters || value == "off" || value == "false";
+        }
+        else if (key == "details-output")
+            config.details_output = value;
+        else if (key == "trace")
+            config.trace = value;
+        else
+        {
+            std::cerr << "Unknown option: " << key << "\n";
+            return false;
+        }
+    }
+    catch (const std::exception &)
+    {
+        ok = false;
+    }
+    if (!ok)
+        std::cerr << "Bad value for " << key << ": " << value << "\n";
+    return ok;
+}
+
+/* Read a flat JSON object of config keys. Values are strings, numbers, booleans or arrays of
+   those; an array becomes the comma-separated list the command line takes.
+*/
+inline bool load_bench_config(const std::string &path, BenchConfig &config)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "Cannot open " << path << "\n";
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string text = buffer.str();
+    size_t pos = 0;
+
+    auto fail = [&](const char *what)
+    {
+        std::cerr << path << ": " << what << " at offset " << pos << "\n";
+        return false;
+    };
+    auto skip_space = [&]
+    {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos])))
+            ++pos;
+    };
+    auto consume = [&](char c)
+    {
+        skip_space();
+        if (pos < text.size() && text[pos] == c)
+        {
+            ++pos;
+            return true;
+        }
+        return false;
+    };
+    // A string (escapes other than \" and \\ are not needed by any key) or a bare scalar
+    auto scalar = [&](std::string &out)
+    {
+        skip_space();
+        out.clear();
+        if (pos < text.size() && text[pos] == '"')
+        {
+            for (++pos; pos < text.size() && text[pos] != '"'; ++pos)
+            {
+                if (text[pos] == '\\' && pos + 1 < text.size())
+                    ++pos;
+                out += text[pos];
+            }
+            return pos++ < text.size();
+        }
+        while (pos < text.size() && (std::isalnum(static_cast<unsigned char>(text[pos])) || text[pos] == '.' ||
+                                     text[pos] == '-' || text[pos] == '+'))
+            out += text[pos++];
+        return !out.empty();
+    };
+
+    if (!consume('{'))
+        return fail("expected '{'");
+    if (consume('}'))
+        return true;
+    do
+    {
+        std::string key, value;
+        if (!scalar(key) || !consume(':'))
+            return fail("expected \"key\":");
+        if (consume('['))
+        {
+            if (!consume(']'))
+            {
+                do
+                {
+                    std::string item;
+                    if (!scalar(item))
+                        return fail("expected an array element");
+                    value += (value.empty() ? "" : ",") + item;
+                } while (consume(','));
+                if (!consume(']'))
+                    return fail("expected ']'");
+            }
+        }
+        else if (!scalar(value))
+            return fail("expected a value");
+        if (!set_bench_option(config, key, value))
+            return false;
+    } while (consume(','));
+    if (!consume('}'))
+        return fail("expected '}'");
+    return true;
+}
+
+// --key=value arguments, --config=<file.json> loading a file in place; false on any error
+inline bool parse_bench_args(int argc, char *argv[], BenchConfig &config)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        size_t eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == std::string::npos)
+        {
+            std::cerr << "Expected --key=value, got " << arg << "\n";
+            return false;
+        }
+        std::string key = arg.substr(2, eq - 2), value = arg.substr(eq + 1);
+        if (key == "config" ? !load_bench_config(value, config) : !set_bench_option(config, key, value))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "stats.h"
+
+using BenchMetrics = std::vector<std::pair<std::string, double>>;
+
+// Metrics of one worker in one phase of a case ("all": the whole run)
+struct BenchDetail
+{
+    uint32_t thread = 0;
+    std::string phase;
+    BenchMetrics metrics;
+};
+
+/* One benchmark case: its configuration as (name, value) fields, the measured runs, extra
+   per-case metrics and per-worker, per-phase details. Times are steady-clock nanoseconds
+   between the workers' start and end barriers; throughput is derived per run, then summarized.
+*/
+struct BenchRow
+{
+    std::vector<std::pair<std::string, std::string>> fields;
+    std::vector<uint64_t> samples_ns;
+    BenchMetrics metrics;
+    std::vector<BenchDetail> details;
+    uint64_t tuples = 0;
+
+    Summary throughput() const // MTuple/sec
+    {
+        std::vector<double> mtps;
+        for (uint64_t ns : samples_ns)
+            mtps.push_back(tuples * 1e3 / ns);
+        return summarize(mtps);
+    }
+
+    Summary nanoseconds() const { return summarize(std::vector<double>(samples_ns.begin(), samples_ns.end())); }
+
+    // Details of worker t in `phase`, added if missing
+    BenchMetrics &detail(uint32_t t, const std::string &phase)
+    {
+        for (BenchDetail &d : details)
+            if (d.thread == t && d.phase == phase)
+                return d.metrics;
+        details.push_back({t, phase, {}});
+        return details.back().metrics;
+    }
+};
+
+// `s` as one CSV field: quoted (RFC 4180, inner quotes doubled) if it holds a comma, quote or line break
+inline std::string csv_field(const std::string &s)
+{
+    if (s.find_first_of(",\"\r\n") == std::string::npos)
+        return s;
+    std::string quoted = "\"";
+    for (char c : s)
+    {
+        if (c == '"')
+            quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// `s` as a JSON string literal, quotes included
+inline std::string json_string(const std::string &s)
+{
+    std::string quoted = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            (quoted += '\\') += c;
+        else if (c == '\n')
+            quoted += "\\n";
+        else if (c == '\t')
+            quoted += "\\t";
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            quoted += escaped;
+        }
+        else
+            quoted += c;
+    }
+    return quoted + "\"";
+}
+
+/* Writes rows as CSV (header from the first row, one line per row, flushed so that long
+   sweeps can be followed) or as a JSON array of objects that also carries the raw samples
+   and the details. CSV details go to their own stream, one line per worker and phase.
+   Field values are quoted and escaped as each format needs.
+*/
+class BenchReport
+{
+public:
+    BenchReport(std::ostream &out, const std::string &format, std::ostream *details = nullptr)
+        : out_(out), details_(details), json_(format == "json")
+    {
+        out_ << std::fixed << std::setprecision(3);
+        if (details_)
+            *details_ << std::fixed << std::setprecision(3);
+    }
+
+    ~BenchReport() { finish(); }
+
+    void add(const BenchRow &row)
+    {
+        const Summary mtps = row.throughput();
+        const Summary ns = row.nanoseconds();
+        const std::pair<const char *, double> stats[] = {
+            {"mtps_median", mtps.median}, {"mtps_p5", mtps.p5}, {"mtps_p95", mtps.p95}, {"mtps_mean", mtps.mean},
+            {"mtps_stddev", mtps.stddev}, {"mtps_ci95_low", mtps.ci95_low}, {"mtps_ci95_high", mtps.ci95_high},
+            {"ns_median", ns.median}, {"ns_p5", ns.p5}, {"ns_p95", ns.p95}};
+
+        if (json_)
+        {
+            out_ << (rows_ == 0 ? "[\n" : ",\n") << "  {";
+            for (const auto &[name, value] : row.fields)
+                out_ << json_string(name) << ": " << json_string(value) << ", ";
+            out_ << "\"repeats\": " << row.samples_ns.size();
+            for (const auto &[name, value] : stats)
+                out_ << ", \"" << name << "\": " << value;
+            for (const auto &[name, value] : row.metrics)
+                out_ << ", \"" << name << "\": " << value;
+            out_ << ", \"samples_ns\": [";
+            for (size_t i = 0; i < row.samples_ns.size(); ++i)
+                out_ << (i ? ", " : "") << row.samples_ns[i];
+            out_ << "]";
+            if (!row.details.empty())
+            {
+                out_ << ", \"details\": [";
+                for (size_t i = 0; i < row.details.size(); ++i)
+                {
+                    const BenchDetail &d = row.details[i];
+                    out_ << (i ? ", " : "") << "{\"thread\": " << d.thread << ", \"phase\": " << json_string(d.phase);
+                    for (const auto &[name, value] : d.metrics)
+                        out_ << ", \"" << name << "\": " << value;
+                    out_ << "}";
+                }
+                out_ << "]";
+            }
+            out_ << "}";
+        }
+        else
+        {
+            if (rows_ == 0)
+            {
+                for (const auto &field : row.fields)
+                    out_ << csv_field(field.first) << ",";
+                out_ << "repeats";
+                for (const auto &stat : stats)
+                    out_ << "," << stat.first;
+                for (const auto &metric : row.metrics)
+                    out_ << "," << metric.first;
+                out_ << "\n";
+            }
+            for (const auto &field : row.fields)
+                out_ << csv_field(field.second) << ",";
+            out_ << row.samples_ns.size();
+            for (const auto &stat : stats)
+                out_ << "," << stat.second;
+            for (const auto &metric : row.metrics)
+                out_ << "," << metric.second;
+            out_ << std::endl;
+            if (details_)
+                add_details(row);
+        }
+        rows_++;
+    }
+
+    void finish()
+    {
+        if (json_ && !finished_)
+            out_ << (rows_ == 0 ? "[]\n" : "\n]\n");
+        finished_ = true;
+        out_.flush();
+    }
+
+private:
+    // One line per worker and phase; the columns are every metric name of the first row's details
+    void add_details(const BenchRow &row)
+    {
+        std::ostream &out = *details_;
+        if (detail_columns_.empty())
+        {
+            for (const BenchDetail &d : row.details)
+                for (const auto &metric : d.metrics)
+                    if (std::find(detail_columns_.begin(), detail_columns_.end(), metric.first) == detail_columns_.end())
+                        detail_columns_.push_back(metric.first);
+            for (const auto &field : row.fields)
+                out << csv_field(field.first) << ",";
+            out << "thread,phase";
+            for (const std::string &column : detail_columns_)
+                out << "," << column;
+            out << "\n";
+        }
+        for (const BenchDetail &d : row.details)
+        {
+            for (const auto &field : row.fields)
+                out << csv_field(field.second) << ",";
+            out << d.thread << "," << csv_field(d.phase);
+            for (const std::string &column : detail_columns_)
+            {
+                out << ",";
+                for (const auto &metric : d.metrics)
+                    if (metric.first == column)
+                        out << metric.second;
+            }
+            out << "\n";
+        }
+        out.flush();
+    }
+
+    std::ostream &out_;
+    std::ostream *details_;
+    std::vector<std::string> detail_columns_;
+    const bool json_;
+    size_t rows_ = 0;
+    bool finished_ = false;
+};
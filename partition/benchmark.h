@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "input.h"
+#include "memory.h"
+#include "partition.h"
+#include "skew.h"
+#include "timeline.h"
+#include "topology.h"
+
+// Constants from paper
+constexpr size_t TUPLES_PER_EXPERIMENT = 1 << 24; // 16M tuples
+constexpr int NUM_REPEATS = 8;
+
+/* Input of `tuples` tuples distributed as `spec`, placed for the workers of `pool`
+   (worker t reads chunk t) and generated by them in parallel.
+*/
+template <typename TupleT = Tuple>
+AlignedArray<TupleT> prepare_input(WorkerPool &pool, const PartitionOptions &opts, const InputSpec &spec,
+                                   size_t tuples = TUPLES_PER_EXPERIMENT)
+{
+    AlignedArray<TupleT> input(tuples, opts.pages);
+    place_array(input, opts.numa, opts.numa_node, pool.size(), opts.cores);
+    generate_input(input.get(), tuples, spec, pool);
+    return input;
+}
+
+/* Partition `input` `repeats` times with the same configuration on the workers of `pool`.
+   The input is only read, so every repeat sees the same tuples; output buffers are reused.
+   Returns the throughput (MTuple/s) of every run, or nothing if a run failed.
+*/
+template <typename Strategy, typename HashFn = MaskHash>
+std::vector<double> measure_throughput(const Tuple *input, size_t tuples, uint32_t bits, int repeats,
+                                       WorkerPool &pool, const PartitionOptions &opts = {})
+{
+    PartitionResult<typename Strategy::template Output<Tuple>> result;
+    std::vector<double> results;
+    for (int i = 0; i < repeats; ++i)
+    {
+        if (!partition_into<Strategy, HashFn>(result, input, tuples, bits, pool, opts))
+            return {};
+        results.push_back(result.throughput());
+    }
+    return results;
+}
+
+// Same on a fresh pool of `threads` workers and input generated once for all repeats
+template <typename Strategy, typename HashFn = MaskHash>
+std::vector<double> measure_throughput(uint32_t threads, uint32_t bits, int repeats,
+                                       const PartitionOptions &opts = {}, const InputSpec &spec = {},
+                                       size_t tuples = TUPLES_PER_EXPERIMENT)
+{
+    WorkerPool pool(threads, opts.cores);
+    AlignedArray<Tuple> input = prepare_input(pool, opts, spec, tuples);
+    return measure_throughput<Strategy, HashFn>(input.get(), tuples, bits, repeats, pool, opts);
+}
+
+inline double average(const std::vector<double> &values)
+{
+    return std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+}
+
+// Result line format parsed by plot_graphs.py
+inline void print_throughput(uint32_t threads, uint32_t bits, double throughput)
+{
+    std::cout << "Threads: " << threads
+              << ", Hash Bits: " << bits
+              << ", Throughput: " << throughput << " MTuple/s\n";
+}
+
+// "direct" or "swwc"; returns false for anything else
+inline bool parse_scatter_mode(const char *arg, ScatterMode &mode)
+{
+    std::string s(arg);
+    if (s == "direct")
+        mode = ScatterMode::Direct;
+    else if (s == "swwc")
+        mode = ScatterMode::WriteCombine;
+    else
+        return false;
+    return true;
+}
+
+// Report the pinned PUs, the page size actually obtained when huge pages were asked for, and the NUMA policy
+inline void report_placement(const PartitionOptions &opts)
+{
+    if (!opts.cores.empty())
+    {
+        std::cerr << "Cores:";
+        for (int core : opts.cores)
+            std::cerr << " " << core;
+        std::cerr << " (" << describe_topology(topology()) << ")\n";
+    }
+    if (opts.pages != PageSize::Default)
+    {
+        AlignedArray<Tuple> probe(HUGE_PAGE_2MB / sizeof(Tuple), opts.pages);
+        std::cerr << "Pages: requested " << page_size_name(opts.pages)
+                  << ", got " << page_size_name(probe.backing()) << "\n";
+    }
+    if (opts.numa != NumaPolicy::FirstTouch)
+    {
+        std::cerr << "NUMA: " << numa_policy_name(opts.numa);
+        if (opts.numa == NumaPolicy::Node)
+            std::cerr << " " << opts.numa_node;
+        std::cerr << " (" << numa_node_count() << " nodes)\n";
+    }
+}
+
+/* Per-worker busy and waiting time of the runs `timeline` observed, with the input tuples each
+   worker took (`worker_tuples`, e.g. PartitionResult::schedule.worker_tuples()), the imbalance and the straggler
+*/
+inline void report_load(const WorkerTimeline &timeline, const std::vector<size_t> &worker_tuples)
+{
+    const LoadBalance load = analyze_load(timeline);
+    const uint32_t threads = timeline.threads();
+    const double runs = std::max(1u, timeline.runs());
+    std::cout << "Imbalance: " << load.imbalance << " (max / mean busy time), straggler worker " << load.straggler << "\n";
+    for (uint32_t t = 0; t < threads; ++t)
+    {
+        const size_t count = worker_tuples[t];
+        const double busy = load.busy_seconds[t] / runs;
+        std::cout << "Worker " << t << ": busy " << busy * 1000.0 << " ms, waited " << load.waited_seconds[t] / runs * 1000.0
+                  << " ms, " << count << " tuples at " << count / busy / 1e6 << " MTuple/s\n";
+    }
+}
+
+// "fixed", "skew-resilient" (sized from a sample) or "growable" (chunk chains); returns false for anything else
+inline bool parse_buffer_sizing(const char *arg, BufferSizing &sizing)
+{
+    std::string s(arg);
+    if (s == "fixed")
+        sizing = BufferSizing::Fixed;
+    else if (s == "skew-resilient")
+        sizing = BufferSizing::Sampled;
+    else if (s == "growable")
+        sizing = BufferSizing::Growable;
+    else
+        return false;
+    return true;
+}
+
+// Report the key distribution and, for skewed input, the hot partitions and heavy hitters a sample finds
+template <typename HashFn = MaskHash>
+void report_input(const InputSpec &spec, uint32_t bits, size_t tuples = TUPLES_PER_EXPERIMENT)
+{
+    std::cerr << "Input: " << describe_input(spec);
+    if (spec.distribution != KeyDistribution::Uniform)
+    {
+        WorkerPool pool(std::max(1u, std::thread::hardware_concurrency()));
+        AlignedArray<Tuple> input(tuples, CACHE_LINE_SIZE);
+        generate_input(input.get(), tuples, spec, pool);
+        SkewProfile profile = sample_skew<HashFn>(input.get(), tuples, bits, 2);
+        std::cerr << ", " << profile.hot_count << " hot of " << profile.partitions << " partitions, "
+                  << profile.heavy_hitters.size() << " heavy hitters";
+        if (!profile.heavy_hitters.empty())
+            std::cerr << " (top key " << 100.0 * profile.heavy_hitters.front().second << "% of tuples)";
+    }
+    std::cerr << "\n";
+}
+
+/* Sweep of the paper's Figure 5: every thread count against every number of hash bits,
+   printing the average throughput of NUM_REPEATS runs per configuration.
+   The input is generated once per thread count (its placement depends on the workers).
+*/
+template <typename Strategy, typename HashFn = MaskHash>
+void run_sweep(const std::vector<uint32_t> &thread_counts, const std::vector<uint32_t> &hash_bits,
+               const PartitionOptions &opts = {}, const InputSpec &spec = {})
+{
+    for (auto threads : thread_counts)
+    {
+        WorkerPool pool(threads, opts.cores);
+        AlignedArray<Tuple> input = prepare_input(pool, opts, spec);
+        for (auto b : hash_bits)
+        {
+            std::vector<double> results =
+                measure_throughput<Strategy, HashFn>(input.get(), input.size(), b, NUM_REPEATS, pool, opts);
+            if (results.size() == NUM_REPEATS)
+                print_throughput(threads, b, average(results));
+        }
+    }
+}
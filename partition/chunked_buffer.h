@@ -0,0 +1,441 @@
+#pragma once
+
+#include <immintrin.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "memory.h"
+#include "numa.h"
+#include "options.h"
+#include "workers.h"
+
+constexpr uint32_t MAX_CHUNK_TUPLES = 256; // 4KB chunks at low fan-out
+constexpr uint32_t MIN_CHUNK_TUPLES = 4;   // never below one 64B cache line
+constexpr uint32_t NO_CHUNK = UINT32_MAX;
+
+/* Pick the chunk size so that the partially filled tail chunks
+   (at most one per writer and partition) stay below half the input.
+*/
+inline uint32_t choose_chunk_tuples(size_t n, uint32_t writers, uint32_t num_partitions)
+{
+    uint32_t chunk_tuples = MAX_CHUNK_TUPLES;
+    while (chunk_tuples > MIN_CHUNK_TUPLES &&
+           static_cast<uint64_t>(writers) * num_partitions * chunk_tuples > n / 2)
+    {
+        chunk_tuples /= 2;
+    }
+    return chunk_tuples;
+}
+
+// Link to the next chunk of the same partition and number of tuples stored
+struct ChunkHeader
+{
+    uint32_t next;
+    uint32_t fill;
+};
+
+/* Pool of fixed-size chunks numbered 0, 1, ... in allocation order. Chunks live in segments:
+   segment 0 holds `base` chunks and segment s >= 1 the next base << (s - 1), so capacity
+   doubles with each segment and a chunk is located without a table walk.
+   Segment 0 is allocated, placed and pre-faulted up front; later segments are mapped when the
+   first chunk in them is allocated and faulted in as they are written, so resident memory
+   follows the data actually stored rather than a worst-case guess.
+*/
+template <typename TupleT>
+class ChunkPool
+{
+public:
+    static constexpr uint32_t MAX_SEGMENTS = 32;
+
+    ChunkPool() = default;
+    ~ChunkPool() { release(); }
+
+    ChunkPool(const ChunkPool &) = delete;
+    ChunkPool &operator=(const ChunkPool &) = delete;
+
+    /* Empty the pool for a run with chunks of chunk_tuples tuples and at least `base` chunks in
+       segment 0. Segments of a previous run with the same chunk size are kept (already placed
+       and faulted in). Chunks are placed like an output array of opts written by `owner_cores`
+       (one core: that worker's node under NumaPolicy::Local; none: shared).
+    */
+    void reset(uint32_t chunk_tuples, uint32_t base, const PartitionOptions &opts, std::vector<int> owner_cores = {})
+    {
+        opts_ = opts;
+        opts_.cores = std::move(owner_cores);
+        if (chunk_tuples != chunk_tuples_ || base > base_)
+        {
+            release();
+            chunk_tuples_ = chunk_tuples;
+            base_ = std::max<uint32_t>(base, 1);
+            segments_[0].store(new_segment(0), std::memory_order_relaxed);
+        }
+        first_data_ = segments_[0].load(std::memory_order_relaxed)->data.get();
+        first_headers_ = segments_[0].load(std::memory_order_relaxed)->headers.get();
+        next_.store(0, std::memory_order_relaxed);
+    }
+
+    // Take a chunk; safe to call from several threads at once
+    uint32_t allocate()
+    {
+        uint32_t c = next_.fetch_add(1, std::memory_order_relaxed);
+        ensure_segment(c);
+        return c;
+    }
+
+    // Take a chunk of a pool used by one thread only: no atomic read-modify-write
+    uint32_t allocate_local()
+    {
+        uint32_t c = next_.load(std::memory_order_relaxed);
+        next_.store(c + 1, std::memory_order_relaxed);
+        ensure_segment(c);
+        return c;
+    }
+
+    TupleT *chunk(uint32_t c) const
+    {
+        if (c < base_)
+            return first_data_ + static_cast<size_t>(c) * chunk_tuples_;
+        uint32_t s = segment_of(c);
+        return segments_[s].load(std::memory_order_acquire)->data.get() + static_cast<size_t>(c - segment_begin(s)) * chunk_tuples_;
+    }
+
+    ChunkHeader &header(uint32_t c) const
+    {
+        if (c < base_)
+            return first_headers_[c];
+        uint32_t s = segment_of(c);
+        return segments_[s].load(std::memory_order_acquire)->headers[c - segment_begin(s)];
+    }
+
+    uint32_t chunk_tuples() const { return chunk_tuples_; }
+    uint32_t allocated() const { return next_.load(std::memory_order_relaxed); }
+
+private:
+    struct Segment
+    {
+        AlignedArray<TupleT> data;
+        std::unique_ptr<ChunkHeader[]> headers;
+    };
+
+    uint32_t segment_of(uint32_t c) const { return static_cast<uint32_t>(std::bit_width(c / base_)); }
+    uint32_t segment_begin(uint32_t s) const { return s == 0 ? 0 : base_ << (s - 1); }
+    size_t segment_chunks(uint32_t s) const { return s == 0 ? base_ : static_cast<size_t>(base_) << (s - 1); }
+
+    Segment *new_segment(uint32_t s) const
+    {
+        auto segment = std::make_unique<Segment>();
+        segment->data = AlignedArray<TupleT>(segment_chunks(s) * chunk_tuples_, opts_.pages);
+        place_array(segment->data, opts_.numa, opts_.numa_node, opts_.cores.empty() ? 0 : 1, opts_.cores);
+        if (s == 0 && opts_.prefault)
+            segment->data.prefault();
+        segment->headers.reset(new ChunkHeader[segment_chunks(s)]);
+        return segment.release();
+    }
+
+    // Map the segment holding chunk c if nobody has; the first thread to publish it wins
+    void ensure_segment(uint32_t c)
+    {
+        if (c < base_)
+            return;
+        uint32_t s = segment_of(c);
+        if (c == NO_CHUNK || s >= MAX_SEGMENTS)
+        {
+            std::cerr << "Chunk pool exhausted at chunk " << c << "\n";
+            std::abort();
+        }
+        if (segments_[s].load(std::memory_order_acquire) != nullptr)
+            return;
+        Segment *segment = new_segment(s);
+        Segment *expected = nullptr;
+        if (!segments_[s].compare_exchange_strong(expected, segment, std::memory_order_acq_rel))
+            delete segment;
+    }
+
+    void release()
+    {
+        for (auto &segment : segments_)
+            delete segment.exchange(nullptr, std::memory_order_relaxed);
+        chunk_tuples_ = 0;
+        base_ = 0;
+    }
+
+    std::atomic<Segment *> segments_[MAX_SEGMENTS] = {};
+    TupleT *first_data_ = nullptr;
+    ChunkHeader *first_headers_ = nullptr;
+    uint32_t chunk_tuples_ = 0;
+    uint32_t base_ = 0;
+    PartitionOptions opts_;
+    alignas(64) std::atomic<uint32_t> next_{0};
+};
+
+// Forward iterator over a chain of chunks, yielding the filled part of each as a span
+template <typename TupleT>
+class ChunkIterator
+{
+public:
+    using value_type = std::span<const TupleT>;
+    using difference_type = std::ptrdiff_t;
+    using iterator_category = std::forward_iterator_tag;
+
+    ChunkIterator() = default;
+    ChunkIterator(const ChunkPool<TupleT> *pool, uint32_t c) : pool_(pool), c_(c) {}
+
+    value_type operator*() const { return {pool_->chunk(c_), pool_->header(c_).fill}; }
+
+    ChunkIterator &operator++()
+    {
+        c_ = pool_->header(c_).next;
+        return *this;
+    }
+
+    ChunkIterator operator++(int)
+    {
+        ChunkIterator before = *this;
+        ++*this;
+        return before;
+    }
+
+    bool operator==(const ChunkIterator &other) const { return c_ == other.c_; }
+
+private:
+    const ChunkPool<TupleT> *pool_ = nullptr;
+    uint32_t c_ = NO_CHUNK;
+};
+
+// The runs of one chunk chain: for (std::span<const TupleT> run : range)
+template <typename TupleT>
+struct ChunkRange
+{
+    const ChunkPool<TupleT> *pool;
+    uint32_t head;
+
+    ChunkIterator<TupleT> begin() const { return {pool, head}; }
+    ChunkIterator<TupleT> end() const { return {pool, NO_CHUNK}; }
+};
+
+/* Partitions grown chunk by chunk and written by all threads at once (concurrent output).
+   A partition's cursor packs its current chunk (high 32 bits) and fill (low 32 bits), so a
+   claim stays a single fetch_add as with fixed buffers. The claim that runs past the end of
+   the chunk takes a fresh one from the pool, links it and publishes it; claims landing behind
+   it wait for the new chunk and retry. Nothing is locked and nothing can overflow.
+*/
+template <typename TupleT>
+struct SharedChunkedPartitions
+{
+    struct alignas(64) Cursor
+    {
+        std::atomic<uint64_t> state;
+        uint32_t head;
+    };
+
+    std::unique_ptr<Cursor[]> cursors;
+    std::vector<uint64_t> counts; // per partition, set by finish()
+    std::unique_ptr<ChunkPool<TupleT>> pool = std::make_unique<ChunkPool<TupleT>>();
+    uint32_t partition_count = 0;
+
+    // Start every partition with one empty chunk
+    void reset(uint32_t partitions, uint32_t chunk_tuples, uint32_t base_chunks, const PartitionOptions &opts)
+    {
+        pool->reset(chunk_tuples, base_chunks + partitions, opts);
+        if (partitions != partition_count)
+            cursors.reset(new Cursor[partitions]);
+        partition_count = partitions;
+        for (uint32_t p = 0; p < partitions; ++p)
+        {
+            uint32_t c = pool->allocate_local();
+            pool->header(c) = {NO_CHUNK, 0};
+            cursors[p].head = c;
+            cursors[p].state.store(static_cast<uint64_t>(c) << 32, std::memory_order_relaxed);
+        }
+        counts.assign(partitions, 0);
+    }
+
+    // Destination of the next k tuples of partition p (k <= chunk size)
+    TupleT *claim(uint32_t p, uint32_t k)
+    {
+        const uint32_t chunk_tuples = pool->chunk_tuples();
+        std::atomic<uint64_t> &state = cursors[p].state;
+        for (;;)
+        {
+            uint64_t s = state.fetch_add(k, std::memory_order_acquire);
+            uint32_t c = static_cast<uint32_t>(s >> 32);
+            uint32_t used = static_cast<uint32_t>(s);
+            if (used + k <= chunk_tuples)
+                return pool->chunk(c) + used;
+            if (used <= chunk_tuples)
+            {
+                // First claim past the end: seal the chunk at `used` and move on to a fresh one
+                uint32_t next = pool->allocate();
+                pool->header(next) = {NO_CHUNK, 0};
+                pool->header(c) = {next, used};
+                state.store(static_cast<uint64_t>(next) << 32 | k, std::memory_order_release);
+                return pool->chunk(next);
+            }
+            // Another thread is replacing the chunk
+            for (uint32_t spins = 0; static_cast<uint32_t>(state.load(std::memory_order_acquire) >> 32) == c; ++spins)
+            {
+                if (spins < 1024)
+                    _mm_pause();
+                else
+                    std::this_thread::yield();
+            }
+        }
+    }
+
+    // Seal partitions [begin, end) once all claims are done: fill of the last chunk and sizes
+    void finish(uint32_t begin, uint32_t end)
+    {
+        const uint32_t chunk_tuples = pool->chunk_tuples();
+        for (uint32_t p = begin; p < end; ++p)
+        {
+            uint64_t s = cursors[p].state.load(std::memory_order_acquire);
+            pool->header(static_cast<uint32_t>(s >> 32)).fill = std::min(static_cast<uint32_t>(s), chunk_tuples);
+            uint64_t total = 0;
+            for (std::span<const TupleT> run : runs(p))
+                total += run.size();
+            counts[p] = total;
+        }
+    }
+
+    uint32_t num_partitions() const { return partition_count; }
+    size_t size(uint32_t p) const { return counts[p]; }
+    ChunkRange<TupleT> runs(uint32_t p) const { return {pool.get(), cursors[p].head}; }
+
+    template <typename F>
+    void for_each_run(uint32_t p, F &&f) const
+    {
+        for (std::span<const TupleT> run : runs(p))
+            f(run.data(), run.size());
+    }
+};
+
+/* Partitions grown chunk by chunk, one set per thread (independent output). Thread t appends
+   to its own chains from its own pool with plain loads and stores, through an Appender.
+*/
+template <typename TupleT>
+struct ThreadChunkedPartitions
+{
+    struct Chain
+    {
+        uint32_t head;
+        uint64_t count;
+    };
+
+    // Chunk an Appender is filling and its fill level
+    struct Cursor
+    {
+        uint32_t chunk;
+        uint32_t used;
+        TupleT *data;
+    };
+
+    std::vector<std::unique_ptr<ChunkPool<TupleT>>> pools; // [thread]
+    std::vector<Chain> chains;                             // [thread][partition]
+    std::vector<Cursor> cursors;                           // [thread][partition], the Appenders' state
+    uint32_t partition_count = 0;
+    uint32_t thread_count = 0;
+
+    // One pool per thread, segment 0 sized for its chunk of the input plus one tail chunk per partition
+    void reset(uint32_t threads, uint32_t partitions, uint32_t chunk_tuples, size_t n, const PartitionOptions &opts)
+    {
+        thread_count = threads;
+        partition_count = partitions;
+        while (pools.size() < threads)
+            pools.push_back(std::make_unique<ChunkPool<TupleT>>());
+        for (uint32_t t = 0; t < threads; ++t)
+        {
+            size_t offset, count;
+            static_chunk(n, threads, t, offset, count);
+            std::vector<int> owner;
+            if (!opts.cores.empty())
+                owner.push_back(opts.cores[t % opts.cores.size()]);
+            pools[t]->reset(chunk_tuples, static_cast<uint32_t>(count / chunk_tuples) + partitions, opts, std::move(owner));
+        }
+        chains.assign(static_cast<size_t>(threads) * partitions, {NO_CHUNK, 0});
+        cursors.assign(static_cast<size_t>(threads) * partitions, {NO_CHUNK, chunk_tuples, nullptr});
+    }
+
+    // Writer of thread t's chains; finish() must be called once the thread is done
+    class Appender
+    {
+    public:
+        Appender(ThreadChunkedPartitions &out, uint32_t t)
+            : pool_(*out.pools[t]), chains_(out.chains.data() + static_cast<size_t>(t) * out.partition_count),
+              cursors_(out.cursors.data() + static_cast<size_t>(t) * out.partition_count), partition_count_(out.partition_count) {}
+
+        TupleT *claim(uint32_t p, uint32_t k)
+        {
+            Cursor &cur = cursors_[p];
+            if (cur.used + k > pool_.chunk_tuples())
+                grow(p, cur);
+            TupleT *slot = cur.data + cur.used;
+            cur.used += k;
+            return slot;
+        }
+
+        void finish()
+        {
+            for (uint32_t p = 0; p < partition_count_; ++p)
+            {
+                Cursor &cur = cursors_[p];
+                if (cur.chunk == NO_CHUNK)
+                    continue;
+                pool_.header(cur.chunk) = {NO_CHUNK, cur.used};
+                chains_[p].count += cur.used;
+            }
+        }
+
+    private:
+        void grow(uint32_t p, Cursor &cur)
+        {
+            uint32_t c = pool_.allocate_local();
+            if (cur.chunk == NO_CHUNK)
+                chains_[p].head = c;
+            else
+            {
+                pool_.header(cur.chunk) = {c, cur.used};
+                chains_[p].count += cur.used;
+            }
+            cur = {c, 0, pool_.chunk(c)};
+        }
+
+        ChunkPool<TupleT> &pool_;
+        Chain *chains_;
+        Cursor *cursors_;
+        uint32_t partition_count_;
+    };
+
+    uint32_t num_partitions() const { return partition_count; }
+
+    size_t size(uint32_t p) const
+    {
+        size_t total = 0;
+        for (uint32_t t = 0; t < thread_count; ++t)
+            total += chains[static_cast<size_t>(t) * partition_count + p].count;
+        return total;
+    }
+
+    // Runs of partition p written by thread t
+    ChunkRange<TupleT> runs(uint32_t t, uint32_t p) const
+    {
+        return {pools[t].get(), chains[static_cast<size_t>(t) * partition_count + p].head};
+    }
+
+    template <typename F>
+    void for_each_run(uint32_t p, F &&f) const
+    {
+        for (uint32_t t = 0; t < thread_count; ++t)
+            for (std::span<const TupleT> run : runs(t, p))
+                f(run.data(), run.size());
+    }
+};
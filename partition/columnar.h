@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "memory.h"
+#include "options.h"
+#include "scatter.h"
+#include "tuple.h"
+#include "workers.h"
+
+/* Columnar (SoA) input: a key column and any number of payload columns, all n rows long.
+   Row i is keys[i], payloads[0][i], payloads[1][i], ...
+*/
+template <typename PayloadT = uint64_t>
+struct ColumnInput
+{
+    const uint64_t *keys = nullptr;
+    std::vector<const PayloadT *> payloads;
+};
+
+/* Partitioned columns: partition p occupies rows [starts[p], starts[p + 1]) of every output
+   column. `ids` keeps the partition id of every input row (and its allocation across runs).
+*/
+template <typename PayloadT = uint64_t>
+struct ColumnarPartitions
+{
+    AlignedArray<uint64_t> keys;
+    std::vector<AlignedArray<PayloadT>> payloads;
+    std::vector<uint64_t> starts; // num_partitions + 1 entries
+    AlignedArray<uint32_t> ids;
+    std::vector<uint64_t> cursors; // [thread][partition] write positions of pass 2, kept across runs
+
+    uint32_t num_partitions() const { return static_cast<uint32_t>(starts.size() - 1); }
+    size_t size(uint32_t p) const { return starts[p + 1] - starts[p]; }
+    const uint64_t *keys_of(uint32_t p) const { return keys.get() + starts[p]; }
+    const PayloadT *payload_of(size_t column, uint32_t p) const { return payloads[column].get() + starts[p]; }
+};
+
+/* Count-then-move over columns. Each thread computes the partition ids of its morsels of the key
+   column once, into the id vector, and counts them; a prefix sum gives every (thread, partition)
+   its exact output position; then every column, keys first, is scattered with the same ids.
+   The key column is hashed once whatever the number of payload columns, and every column is
+   read sequentially and written through 2^bits cursors of its own element width.
+*/
+struct ColumnarCountThenMove
+{
+    static constexpr const char *name = "columnar";
+
+    template <typename PayloadT>
+    using Output = ColumnarPartitions<PayloadT>;
+
+    template <typename HashFn, typename PayloadT>
+    static bool run(const ColumnInput<PayloadT> &input, size_t n, uint32_t bits, WorkerPool &pool,
+                    const PartitionOptions &opts, PartitionResult<Output<PayloadT>> &result, HashFn hash = {})
+    {
+        const uint32_t threads = pool.size();
+        const size_t columns = input.payloads.size();
+        Output<PayloadT> &out = result.output;
+        const uint32_t num_partitions = 1u << bits;
+        try
+        {
+            reuse_or_allocate(out.keys, n, opts);
+            out.payloads.resize(columns);
+            for (AlignedArray<PayloadT> &column : out.payloads)
+                reuse_or_allocate(column, n, opts);
+            reuse_or_allocate(out.ids, n, opts, threads);
+            out.starts.assign(static_cast<size_t>(num_partitions) + 1, 0);
+            out.cursors.resize(static_cast<size_t>(threads) * num_partitions);
+        }
+        catch (const std::bad_alloc &e)
+        {
+            std::cerr << "Memory allocation failed: " << e.what() << "\n";
+            return false;
+        }
+
+        // histograms[t * num_partitions + p]: rows of thread t in partition p, then its first output row
+        std::vector<uint64_t> histograms(static_cast<size_t>(threads) * num_partitions, 0);
+        const WideTuple<8> *keys = reinterpret_cast<const WideTuple<8> *>(input.keys);
+        SenseBarrier &sync_point = pool.barrier();
+
+        start_schedule(result.schedule, n, threads, opts);
+
+        result.seconds = pool.run([&](uint32_t t)
+                                  {
+            uint64_t* hist = histograms.data() + static_cast<size_t>(t) * num_partitions;
+            uint32_t* ids = out.ids.get();
+
+            // Pass 1: ids of the morsels' keys, kept for every column, and their histogram
+            result.schedule.run(t, [&](size_t offset, size_t count) {
+                for (size_t base = offset; base < offset + count; base += HASH_BATCH) {
+                    size_t m = std::min(HASH_BATCH, offset + count - base);
+                    partition_ids(keys + base, m, bits, hash, ids + base);
+                    for (size_t j = 0; j < m; ++j)
+                        hist[ids[base + j]]++;
+                }
+            });
+            sync_point.arrive_and_wait();
+            if (t == 0) {
+                uint64_t sum = 0;
+                for (uint32_t p = 0; p < num_partitions; ++p) {
+                    out.starts[p] = sum;
+                    for (uint32_t u = 0; u < threads; ++u) {
+                        uint64_t& cell = histograms[static_cast<size_t>(u) * num_partitions + p];
+                        uint64_t c = cell;
+                        cell = sum;
+                        sum += c;
+                    }
+                }
+                out.starts[num_partitions] = sum;
+            }
+            sync_point.arrive_and_wait();
+
+            // Pass 2: every column scattered by the same ids from the thread's own cursors
+            uint64_t* cursors = out.cursors.data() + static_cast<size_t>(t) * num_partitions;
+            auto scatter_column = [&](const auto* src, auto* dst) {
+                std::copy(hist, hist + num_partitions, cursors);
+                result.schedule.replay(t, [&](size_t offset, size_t count) {
+                    for (size_t i = offset; i < offset + count; ++i)
+                        dst[cursors[ids[i]]++] = src[i];
+                });
+            };
+            scatter_column(input.keys, out.keys.get());
+            for (size_t c = 0; c < columns; ++c)
+                scatter_column(input.payloads[c], out.payloads[c].get()); });
+        return true;
+    }
+};
+
+// Partition `input` with the workers of `pool` into `result`, reusing the columns it already holds
+template <typename HashFn = MaskHash, typename PayloadT = uint64_t>
+bool partition_columns_into(PartitionResult<ColumnarPartitions<PayloadT>> &result, const ColumnInput<PayloadT> &input,
+                            size_t n, uint32_t bits, WorkerPool &pool, const PartitionOptions &opts = {}, HashFn hash = {})
+{
+    auto begin = WorkerClock::now();
+    result.tuples = n;
+    result.ok = ColumnarCountThenMove::run(input, n, bits, pool, opts, result, hash);
+    auto end = WorkerClock::now();
+    if (result.ok)
+    {
+        const WorkerRun &run = pool.last_run();
+        result.setup_seconds = std::chrono::duration<double>(run.started - begin).count();
+        result.teardown_seconds = std::chrono::duration<double>(end - run.finished).count();
+    }
+    return result.ok;
+}
+
+/* The columns of a row input: the keys and one column per payload word of TupleT, so that
+   the same input can be partitioned in both layouts.
+*/
+template <typename TupleT>
+struct RowColumns
+{
+    AlignedArray<uint64_t> keys;
+    std::vector<AlignedArray<uint64_t>> payloads;
+
+    RowColumns(const TupleT *rows, size_t n) : keys(n, CACHE_LINE_SIZE)
+    {
+        constexpr size_t words = sizeof(TupleT) / 8 - 1;
+        for (size_t c = 0; c < words; ++c)
+            payloads.emplace_back(n, CACHE_LINE_SIZE);
+        for (size_t i = 0; i < n; ++i)
+        {
+            const uint64_t *row = reinterpret_cast<const uint64_t *>(rows + i);
+            keys[i] = row[0];
+            for (size_t c = 0; c < words; ++c)
+                payloads[c][i] = row[1 + c];
+        }
+    }
+
+    ColumnInput<uint64_t> input() const
+    {
+        ColumnInput<uint64_t> columns{keys.get(), {}};
+        for (const AlignedArray<uint64_t> &column : payloads)
+            columns.payloads.push_back(column.get());
+        return columns;
+    }
+};
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "chunked_buffer.h"
+#include "memory.h"
+#include "options.h"
+#include "scatter.h"
+#include "skew.h"
+#include "workers.h"
+
+/* Capacity of a partition buffer expected to receive `expected` tuples: twice the
+   expectation plus a few lines of slack for very small partitions, in whole cache lines
+   so that write-combined lines stay 64B aligned.
+*/
+template <typename TupleT>
+inline uint32_t overprovisioned_capacity(size_t expected)
+{
+    constexpr uint32_t line_tuples = WriteCombiner<TupleT>::TUPLES_PER_LINE;
+    size_t capacity = expected * 2 + 4 * line_tuples;
+    return static_cast<uint32_t>((capacity + line_tuples - 1) / line_tuples * line_tuples);
+}
+
+// Capacity of a buffer sized from a sampled upper bound (skew.h): the bound plus a few lines of slack
+template <typename TupleT>
+inline uint32_t sampled_capacity(size_t bound)
+{
+    constexpr uint32_t line_tuples = WriteCombiner<TupleT>::TUPLES_PER_LINE;
+    size_t capacity = bound + 4 * line_tuples;
+    return static_cast<uint32_t>((capacity + line_tuples - 1) / line_tuples * line_tuples);
+}
+
+template <typename TupleT>
+struct SharedPartitionBuffer
+{
+    alignas(64) std::atomic<uint32_t> write_idx;
+    uint32_t capacity;
+    uint32_t filled; // tuples written: capacity, or the start of the one claim that ran past it
+    TupleT *data;
+
+    size_t size() const { return std::min(write_idx.load(std::memory_order_relaxed), filled); }
+};
+
+/* One output buffer per partition, shared among threads (slices of one allocation).
+   A hot partition of a skew-resilient run has one sub-buffer per thread instead:
+   partition p owns buffers[first[p], first[p + 1]). Tuples a skew-resilient buffer has no room
+   for go to the partition's chain in `spill`.
+   Growable runs use `chunked` instead of the buffers.
+*/
+template <typename TupleT>
+struct SharedPartitions
+{
+    std::unique_ptr<SharedPartitionBuffer<TupleT>[]> buffers;
+    std::vector<uint32_t> first; // num_partitions + 1 entries
+    AlignedArray<TupleT> storage;
+    SharedChunkedPartitions<TupleT> chunked;
+    SharedChunkedPartitions<TupleT> spill;
+    WriteCombiners<TupleT> combiners; // SWWC staging of every worker, kept across runs
+    uint32_t partition_count = 0;
+    bool growable = false;
+    bool spills = false;
+
+    uint32_t num_partitions() const { return partition_count; }
+
+    size_t size(uint32_t p) const
+    {
+        if (growable)
+            return chunked.size(p);
+        size_t total = spills ? spill.size(p) : 0;
+        for (uint32_t b = first[p]; b < first[p + 1]; ++b)
+            total += buffers[b].size();
+        return total;
+    }
+
+    template <typename F>
+    void for_each_run(uint32_t p, F &&f) const
+    {
+        if (growable)
+        {
+            chunked.for_each_run(p, f);
+            return;
+        }
+        for (uint32_t b = first[p]; b < first[p + 1]; ++b)
+            f(static_cast<const TupleT *>(buffers[b].data), buffers[b].size());
+        if (spills)
+            spill.for_each_run(p, f);
+    }
+};
+
+/* Concurrent Output: all threads write into shared per-partition buffers and claim
+   slots with an atomic fetch_add on the partition's write index.
+   Skew-resilient runs size each buffer from a sample and give hot partitions one sub-buffer
+   per thread, so a heavy hitter neither overflows its buffer nor serializes all threads
+   on one write index; the rare tuples past a sampled bound spill into chunk chains.
+   Growable runs claim slots in chunk chains that cannot overflow.
+*/
+struct ConcurrentOutput
+{
+    static constexpr const char *name = "concurrent";
+    static constexpr uint32_t MAX_BITS = 18; // fixed over-provisioned buffers grow too large beyond this
+
+    template <typename TupleT>
+    using Output = SharedPartitions<TupleT>;
+
+    template <typename HashFn, typename TupleT>
+    static bool run(const TupleT *input, size_t n, uint32_t bits, WorkerPool &pool,
+                    const PartitionOptions &opts, PartitionResult<Output<TupleT>> &result, HashFn hash = {})
+    {
+        const uint32_t threads = pool.size();
+        Output<TupleT> &out = result.output;
+        out.partition_count = 1u << bits;
+        out.growable = opts.buffers == BufferSizing::Growable;
+
+        if (out.growable)
+        {
+            // Chunks of whole cache lines, sized so that one partial chunk per partition stays small
+            const uint32_t line_tuples = WriteCombiner<TupleT>::TUPLES_PER_LINE;
+            const uint32_t chunk_tuples = std::max(line_tuples, choose_chunk_tuples(n, 1, out.partition_count));
+            try
+            {
+                out.chunked.reset(out.partition_count, chunk_tuples, static_cast<uint32_t>(n / chunk_tuples), opts);
+            }
+            catch (const std::bad_alloc &e)
+            {
+                std::cerr << "Memory allocation failed for " << out.partition_count << " partitions: " << e.what() << "\n";
+                return false;
+            }
+        }
+        else if (!layout_buffers(input, n, bits, threads, opts, out, hash))
+            return false;
+
+        // Claim k slots of buffer b (of partition p) for the calling thread
+        auto claim = [&out](uint32_t b, uint32_t p, uint32_t k)
+        {
+            SharedPartitionBuffer<TupleT> &buf = out.buffers[b];
+            uint32_t idx = buf.write_idx.fetch_add(k, std::memory_order_relaxed);
+            if (idx + k <= buf.capacity)
+                return buf.data + idx;
+            if (!out.spills)
+            {
+                std::cerr << "Buffer overflow at partition " << p << ", idx = " << idx << "\n";
+                std::abort();
+            }
+            // Only one claim crosses the end; the slots it leaves behind stay empty
+            if (idx < buf.capacity)
+                buf.filled = idx;
+            return out.spill.claim(p, k);
+        };
+
+        if (opts.scatter != ScatterMode::Direct)
+        {
+            try
+            {
+                reserve_combiners(out.combiners, threads, out.partition_count, detect_stream_kernel().stream_line);
+            }
+            catch (const std::bad_alloc &e)
+            {
+                std::cerr << "Memory allocation failed for " << threads << " write combiners: " << e.what() << "\n";
+                return false;
+            }
+        }
+        SenseBarrier &sync_point = pool.barrier();
+
+        // Hot sub-buffers are sized from a sample of their worker's chunk: workers keep to their chunks
+        start_schedule(result.schedule, n, threads, opts, opts.buffers == BufferSizing::Sampled ? 1.0 : 0.0);
+
+        // Scatter the morsels of thread t, claiming slots through reserve(p, k)
+        auto scatter_chunk = [&](uint32_t t, auto &&reserve)
+        {
+            if (opts.scatter == ScatterMode::Direct)
+            {
+                result.schedule.run(t, [&](size_t offset, size_t count)
+                                    { scatter_direct(input + offset, count, bits, reserve, hash, RowStores::Cached); });
+                return;
+            }
+
+            // SWWC: one fetch_add per full line instead of per tuple (per row for 64B rows)
+            WriteCombiner<TupleT> &wc = *out.combiners[t];
+            result.schedule.run(t, [&](size_t offset, size_t count)
+                                { scatter_write_combined(input + offset, count, bits, wc, reserve, hash, RowStores::Cached); });
+            // Partial lines break the line alignment, so they go last, after every thread
+            // has reserved its full lines
+            sync_point.arrive_and_wait();
+            drain_write_combined(wc, reserve);
+        };
+
+        // Seal an owned range of chunked partitions once every claim is done
+        const uint32_t partitions_per_thread = (out.partition_count + threads - 1) / threads;
+        auto finish_chunked = [&](uint32_t t, SharedChunkedPartitions<TupleT> &chunked)
+        {
+            sync_point.arrive_and_wait();
+            uint32_t p_begin = std::min(out.partition_count, t * partitions_per_thread);
+            chunked.finish(p_begin, std::min(out.partition_count, p_begin + partitions_per_thread));
+        };
+
+        result.seconds = pool.run([&](uint32_t t)
+                                  {
+            if (out.growable) {
+                scatter_chunk(t, [&](uint32_t p, uint32_t k) { return out.chunked.claim(p, k); });
+                finish_chunked(t, out.chunked);
+                return;
+            }
+            if (opts.buffers != BufferSizing::Sampled) {
+                scatter_chunk(t, [&](uint32_t p, uint32_t k) { return claim(p, p, k); });
+                return;
+            }
+            // A partition with several buffers is hot: thread t owns sub-buffer t
+            const uint32_t *first = out.first.data();
+            scatter_chunk(t, [&, first](uint32_t p, uint32_t k) {
+                uint32_t b = first[p];
+                if (first[p + 1] - b > 1)
+                    b += t;
+                return claim(b, p, k);
+            });
+            finish_chunked(t, out.spill); });
+        return true;
+    }
+
+private:
+    // Lay out the fixed-capacity buffers: uniform sizes, or sampled sizes with split hot partitions
+    template <typename HashFn, typename TupleT>
+    static bool layout_buffers(const TupleT *input, size_t n, uint32_t bits, uint32_t threads,
+                               const PartitionOptions &opts, Output<TupleT> &out, HashFn hash)
+    {
+        // Sampled sizes never go below the uniform ones, which small sample counts underestimate.
+        const uint32_t uniform_capacity = overprovisioned_capacity<TupleT>(n / out.partition_count);
+        const uint32_t uniform_thread_capacity = overprovisioned_capacity<TupleT>(n / threads / out.partition_count);
+        std::vector<uint32_t> capacities;
+        out.first.resize(static_cast<size_t>(out.partition_count) + 1);
+        SkewProfile profile;
+        if (opts.buffers == BufferSizing::Sampled)
+            profile = sample_skew(input, n, bits, threads, hash);
+        for (uint32_t p = 0; p < out.partition_count; ++p)
+        {
+            out.first[p] = static_cast<uint32_t>(capacities.size());
+            if (opts.buffers != BufferSizing::Sampled)
+                capacities.push_back(uniform_capacity);
+            else if (profile.hot[p])
+                for (uint32_t t = 0; t < threads; ++t)
+                    capacities.push_back(std::max(uniform_thread_capacity, sampled_capacity<TupleT>(profile.bound(t, p))));
+            else
+                capacities.push_back(std::max(uniform_capacity, sampled_capacity<TupleT>(profile.bound(p))));
+        }
+        const uint32_t buffer_count = static_cast<uint32_t>(capacities.size());
+        out.first[out.partition_count] = buffer_count;
+        out.spills = opts.buffers == BufferSizing::Sampled;
+        size_t total_capacity = 0;
+        for (uint32_t c : capacities)
+            total_capacity += c;
+
+        try
+        {
+            out.buffers.reset(new SharedPartitionBuffer<TupleT>[buffer_count]);
+            reuse_or_allocate(out.storage, total_capacity, opts);
+            // One line per spill chunk: one empty chunk per partition is all most runs allocate
+            if (out.spills)
+                out.spill.reset(out.partition_count, WriteCombiner<TupleT>::TUPLES_PER_LINE, 0, opts);
+        }
+        catch (const std::bad_alloc &e)
+        {
+            std::cerr << "Memory allocation failed for " << out.partition_count << " partitions: " << e.what() << "\n";
+            return false;
+        }
+        size_t offset = 0;
+        for (uint32_t b = 0; b < buffer_count; ++b)
+        {
+            out.buffers[b].write_idx.store(0);
+            out.buffers[b].capacity = capacities[b];
+            out.buffers[b].filled = capacities[b];
+            out.buffers[b].data = out.storage.get() + offset;
+            offset += capacities[b];
+        }
+        return true;
+    }
+};
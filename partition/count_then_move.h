@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "memory.h"
+#include "options.h"
+#include "scatter.h"
+#include "workers.h"
+
+/* One contiguous array holding all partitions back to back.
+   Partition p occupies data[starts[p], starts[p + 1]).
+*/
+template <typename TupleT>
+struct ContiguousPartitions
+{
+    AlignedArray<TupleT> data;
+    std::vector<uint64_t> starts;    // num_partitions + 1 entries
+    AlignedArray<TupleT> scratch;    // multi-pass: the other ping-pong array, kept for the next run
+    std::vector<uint64_t> cursors;   // multi-pass: [thread][sub-partition] cursors of passes 1..k
+
+    uint32_t num_partitions() const { return static_cast<uint32_t>(starts.size() - 1); }
+    size_t size(uint32_t p) const { return starts[p + 1] - starts[p]; }
+
+    template <typename F>
+    void for_each_run(uint32_t p, F &&f) const { f(static_cast<const TupleT *>(data.get() + starts[p]), size(p)); }
+};
+
+/* Count-then-move: each thread builds a histogram of the morsels it takes, a parallel prefix
+   sum turns the histograms into exact per-thread write offsets, and a second pass scatters
+   the same morsels without atomics. Output is contiguous and sized exactly to the input.
+*/
+struct CountThenMove
+{
+    static constexpr const char *name = "count_then_move";
+
+    template <typename TupleT>
+    using Output = ContiguousPartitions<TupleT>;
+
+    template <typename HashFn, typename TupleT>
+    static bool run(const TupleT *input, size_t n, uint32_t bits, WorkerPool &pool,
+                    const PartitionOptions &opts, PartitionResult<Output<TupleT>> &result, HashFn hash = {})
+    {
+        const uint32_t threads = pool.size();
+        Output<TupleT> &out = result.output;
+        const uint32_t num_partitions = 1u << bits;
+        try
+        {
+            reuse_or_allocate(out.data, n, opts);
+            out.starts.assign(static_cast<size_t>(num_partitions) + 1, 0);
+        }
+        catch (const std::bad_alloc &e)
+        {
+            std::cerr << "Memory allocation failed: " << e.what() << "\n";
+            return false;
+        }
+
+        // histograms[t * num_partitions + p]: tuples of thread t falling into partition p.
+        // After the prefix sum it holds the write cursor of thread t inside partition p.
+        std::vector<uint64_t> histograms(static_cast<size_t>(threads) * num_partitions, 0);
+        // Sum of the partition totals of each thread's partition range, for the two-level scan
+        std::vector<uint64_t> range_sums(threads, 0);
+        uint32_t partitions_per_thread = (num_partitions + threads - 1) / threads;
+        SenseBarrier &sync_point = pool.barrier();
+
+        start_schedule(result.schedule, n, threads, opts);
+
+        result.seconds = pool.run([&](uint32_t t)
+                                  {
+            uint64_t* hist = histograms.data() + static_cast<size_t>(t) * num_partitions;
+
+            // Pass 1: private histogram over the thread's morsels
+            result.schedule.run(t, [&](size_t offset, size_t count) { histogram(input + offset, count, bits, hist, hash); });
+            sync_point.arrive_and_wait();
+
+            // Prefix sum, step 1: every thread owns a range of partitions and turns the
+            // per-thread counts of those partitions into offsets relative to the partition start
+            uint32_t p_begin = std::min(num_partitions, t * partitions_per_thread);
+            uint32_t p_end = std::min(num_partitions, p_begin + partitions_per_thread);
+            uint64_t range_total = 0;
+            for (uint32_t p = p_begin; p < p_end; ++p) {
+                uint64_t partition_total = 0;
+                for (uint32_t u = 0; u < threads; ++u) {
+                    uint64_t& cell = histograms[static_cast<size_t>(u) * num_partitions + p];
+                    uint64_t c = cell;
+                    cell = partition_total;
+                    partition_total += c;
+                }
+                out.starts[p] = partition_total; // temporarily the partition size
+                range_total += partition_total;
+            }
+            range_sums[t] = range_total;
+            sync_point.arrive_and_wait();
+
+            // Prefix sum, step 2: offset the owned range by the sizes of all preceding ranges
+            uint64_t base = 0;
+            for (uint32_t u = 0; u < t; ++u) {
+                base += range_sums[u];
+            }
+            for (uint32_t p = p_begin; p < p_end; ++p) {
+                uint64_t size = out.starts[p];
+                out.starts[p] = base;
+                for (uint32_t u = 0; u < threads; ++u) {
+                    histograms[static_cast<size_t>(u) * num_partitions + p] += base;
+                }
+                base += size;
+            }
+            if (t == threads - 1) {
+                out.starts[num_partitions] = n;
+            }
+            sync_point.arrive_and_wait();
+
+            // Pass 2: scatter the same morsels to exact, thread-private positions (no atomics)
+            TupleT* data = out.data.get();
+            result.schedule.replay(t, [&](size_t offset, size_t count) {
+                scatter_direct(input + offset, count, bits,
+                               [&](uint32_t p, uint32_t) { return data + hist[p]++; }, hash);
+            }); });
+        return true;
+    }
+};
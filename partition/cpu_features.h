@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cpuid.h>
+#include <cstdint>
+
+// Instruction set extensions usable by this process: supported by the CPU (CPUID) and enabled by the OS (XCR0)
+struct CpuFeatures
+{
+    bool avx2 = false;
+    bool avx512f = false;
+    bool avx512cd = false;
+};
+
+// XCR0 tells whether the OS saves the YMM/ZMM state on context switches
+inline uint64_t read_xcr0()
+{
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+}
+
+inline CpuFeatures detect_cpu_features()
+{
+    CpuFeatures features;
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_OSXSAVE))
+        return features;
+
+    uint64_t xcr0 = read_xcr0();
+    bool ymm_enabled = (xcr0 & 0x6) == 0x6;   // SSE + AVX state
+    bool zmm_enabled = (xcr0 & 0xe6) == 0xe6; // + opmask and both ZMM halves
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        return features;
+
+    features.avx2 = (ebx & bit_AVX2) && ymm_enabled;
+    features.avx512f = (ebx & bit_AVX512F) && zmm_enabled;
+    features.avx512cd = (ebx & bit_AVX512CD) && zmm_enabled;
+    return features;
+}
+
+// Detected once per process
+inline const CpuFeatures &cpu_features()
+{
+    static const CpuFeatures features = detect_cpu_features();
+    return features;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <immintrin.h>
+#include <cstdint>
+
+// GCC 12 reports the deliberately undefined upper lanes inside its AVX-512 intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+/* Partition functions. Every strategy is templated on one of these functors:
+   `hash(key, b)` returns the partition index in [0, 2^b). The strategies call the instance
+   they are given, a default-constructed one unless the functor carries state (range_partition.h).
+   The vector overloads hash 4 (AVX2) or 8 (AVX-512) keys held in 64-bit lanes at once;
+   they are only called from kernels compiled for that instruction set (simd_hash.h).
+*/
+
+// A HashFn with AVX2 and AVX-512 overloads, usable by the SIMD kernels
+template <typename HashFn>
+concept VectorHash = requires(const HashFn h, __m256i k4, __m512i k8, uint32_t b) {
+    h(k4, b);
+    h(k8, b);
+};
+
+// Bitmask hash: the lowest b bits of the key select the partition (faster than key % 2^b)
+struct MaskHash
+{
+    static constexpr const char *name = "mask";
+
+    inline uint32_t operator()(uint64_t key, uint32_t b) const
+    {
+        return key & ((1u << b) - 1);
+    }
+
+    __attribute__((target("avx2"))) inline __m256i operator()(__m256i keys, uint32_t b) const
+    {
+        return _mm256_and_si256(keys, _mm256_set1_epi64x((1u << b) - 1));
+    }
+
+    __attribute__((target("avx512f"))) inline __m512i operator()(__m512i keys, uint32_t b) const
+    {
+        return _mm512_and_si512(keys, _mm512_set1_epi64((1u << b) - 1));
+    }
+};
+
+/* Multiplicative hash (from paper): the top b bits of key * 0x5bd1e995.
+   The multiplier fits in 32 bits, so the 64-bit product is lo(key) * m + (hi(key) * m << 32),
+   which the vector versions build from two 32x32->64 bit multiplies (no AVX-512DQ needed).
+*/
+struct MultiplicativeHash
+{
+    static constexpr const char *name = "multiplicative";
+    static constexpr uint64_t multiplier = 0x5bd1e995;
+
+    inline uint32_t operator()(uint64_t key, uint32_t b) const
+    {
+        return b == 0 ? 0 : static_cast<uint32_t>((key * multiplier) >> (64 - b));
+    }
+
+    __attribute__((target("avx2"))) inline __m256i operator()(__m256i keys, uint32_t b) const
+    {
+        const __m256i m = _mm256_set1_epi64x(multiplier);
+        __m256i lo = _mm256_mul_epu32(keys, m);
+        __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(keys, 32), m);
+        __m256i product = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+        return _mm256_srl_epi64(product, _mm_cvtsi32_si128(64 - b)); // a shift by 64 yields 0
+    }
+
+    __attribute__((target("avx512f"))) inline __m512i operator()(__m512i keys, uint32_t b) const
+    {
+        const __m512i m = _mm512_set1_epi64(multiplier);
+        __m512i lo = _mm512_mul_epu32(keys, m);
+        __m512i hi = _mm512_mul_epu32(_mm512_srli_epi64(keys, 32), m);
+        __m512i product = _mm512_add_epi64(lo, _mm512_slli_epi64(hi, 32));
+        return _mm512_srl_epi64(product, _mm_cvtsi32_si128(64 - b));
+    }
+};
+
+/* One radix digit of another hash: bits [shift, shift + bits) of hash(key, total_bits).
+   Multi-pass partitioning runs the single-pass kernels with this on every pass.
+*/
+template <typename HashFn>
+struct RadixDigit
+{
+    uint32_t total_bits;
+    uint32_t shift;
+    HashFn hash = {};
+
+    inline uint32_t operator()(uint64_t key, uint32_t bits) const
+    {
+        return (hash(key, total_bits) >> shift) & ((1u << bits) - 1);
+    }
+
+    __attribute__((target("avx2"))) inline __m256i operator()(__m256i keys, uint32_t bits) const
+        requires VectorHash<HashFn>
+    {
+        __m256i h = _mm256_srl_epi64(hash(keys, total_bits), _mm_cvtsi32_si128(shift));
+        return _mm256_and_si256(h, _mm256_set1_epi64x((1u << bits) - 1));
+    }
+
+    __attribute__((target("avx512f"))) inline __m512i operator()(__m512i keys, uint32_t bits) const
+        requires VectorHash<HashFn>
+    {
+        __m512i h = _mm512_srl_epi64(hash(keys, total_bits), _mm_cvtsi32_si128(shift));
+        return _mm512_and_si512(h, _mm512_set1_epi64((1u << bits) - 1));
+    }
+};
+
+#pragma GCC diagnostic pop
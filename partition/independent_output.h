@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "chunked_buffer.h"
+#include "concurrent_output.h"
+#include "memory.h"
+#include "options.h"
+#include "scatter.h"
+#include "skew.h"
+#include "workers.h"
+
+/* Every thread owns one buffer per partition; partition p is the union of the
+   threads' p-th buffers (fragmented output, no contention).
+   Buffers have one capacity, or, when sized from a sample, buffer [t][p] starts at
+   offsets[t * partition_count + p] and ends where the next one starts; tuples a sampled buffer
+   has no room for go to thread t's chain of partition p in `spill`.
+   Growable runs use `chunked` instead of the buffers.
+*/
+template <typename TupleT>
+struct ThreadPartitions
+{
+    AlignedArray<TupleT> storage;   // [thread][partition][capacity]
+    std::vector<uint32_t> counts;   // [thread][partition]
+    std::vector<size_t> offsets;    // sampled sizes: threads * partitions + 1 entries; empty otherwise
+    ThreadChunkedPartitions<TupleT> chunked;
+    ThreadChunkedPartitions<TupleT> spill;
+    WriteCombiners<TupleT> combiners; // SWWC staging of every worker, kept across runs
+    uint32_t partition_count = 0;
+    uint32_t thread_count = 0;
+    uint32_t capacity = 0;
+    bool growable = false;
+    bool spills = false;
+
+    uint32_t num_partitions() const { return partition_count; }
+
+    const TupleT *buffer(uint32_t t, uint32_t p) const
+    {
+        size_t i = static_cast<size_t>(t) * partition_count + p;
+        return storage.get() + (offsets.empty() ? i * capacity : offsets[i]);
+    }
+
+    size_t size(uint32_t p) const
+    {
+        if (growable)
+            return chunked.size(p);
+        size_t total = spills ? spill.size(p) : 0;
+        for (uint32_t t = 0; t < thread_count; ++t)
+            total += counts[static_cast<size_t>(t) * partition_count + p];
+        return total;
+    }
+
+    template <typename F>
+    void for_each_run(uint32_t p, F &&f) const
+    {
+        if (growable)
+        {
+            chunked.for_each_run(p, f);
+            return;
+        }
+        for (uint32_t t = 0; t < thread_count; ++t)
+            f(buffer(t, p), static_cast<size_t>(counts[static_cast<size_t>(t) * partition_count + p]));
+        if (spills)
+            spill.for_each_run(p, f);
+    }
+};
+
+/* Independent Output: each thread scatters its input morsels into private
+   per-partition buffers with plain (non-atomic) write indices.
+   Skew-resilient runs size every buffer from a sample of the owning thread's chunk and spill
+   the rare tuples past a buffer's bound into chunk chains; growable runs append to per-thread
+   chunk chains instead.
+*/
+struct IndependentOutput
+{
+    static constexpr const char *name = "independent";
+
+    template <typename TupleT>
+    using Output = ThreadPartitions<TupleT>;
+
+    template <typename HashFn, typename TupleT>
+    static bool run(const TupleT *input, size_t n, uint32_t bits, WorkerPool &pool,
+                    const PartitionOptions &opts, PartitionResult<Output<TupleT>> &result, HashFn hash = {})
+    {
+        const uint32_t threads = pool.size();
+        Output<TupleT> &out = result.output;
+        out.partition_count = 1u << bits;
+        out.thread_count = threads;
+        out.growable = opts.buffers == BufferSizing::Growable;
+        if (out.growable)
+        {
+            // Chunks of whole cache lines; at most one partial chunk per thread and partition
+            const uint32_t line_tuples = WriteCombiner<TupleT>::TUPLES_PER_LINE;
+            const uint32_t chunk_tuples = std::max(line_tuples, choose_chunk_tuples(n, threads, out.partition_count));
+            try
+            {
+                out.chunked.reset(threads, out.partition_count, chunk_tuples, n, opts);
+            }
+            catch (const std::bad_alloc &e)
+            {
+                std::cerr << "Memory allocation failed for " << threads << " x " << out.partition_count
+                          << " chunk chains: " << e.what() << "\n";
+                return false;
+            }
+        }
+        else if (!layout_buffers(input, n, bits, threads, opts, out, hash))
+            return false;
+
+        if (opts.scatter != ScatterMode::Direct)
+        {
+            try
+            {
+                reserve_combiners(out.combiners, threads, out.partition_count, detect_stream_kernel().stream_line);
+            }
+            catch (const std::bad_alloc &e)
+            {
+                std::cerr << "Memory allocation failed for " << threads << " write combiners: " << e.what() << "\n";
+                return false;
+            }
+        }
+
+        /* Private buffers are sized for one worker's chunk: fixed ones (twice the expected size)
+           take up to 1.5 chunks; sampled ones, sized from a sample of that very chunk, keep
+           to it and steal nothing; growable ones take any morsels
+        */
+        const double budget = opts.buffers == BufferSizing::Fixed ? 1.5 : opts.buffers == BufferSizing::Sampled ? 1.0 : 0.0;
+        start_schedule(result.schedule, n, threads, opts, budget);
+
+        // Scatter the morsels of thread t, claiming slots through reserve(p, k)
+        auto scatter_chunk = [&](uint32_t t, auto &&reserve)
+        {
+            if (opts.scatter == ScatterMode::Direct)
+            {
+                result.schedule.run(t, [&](size_t offset, size_t count)
+                                    { scatter_direct(input + offset, count, bits, reserve, hash); });
+                return;
+            }
+
+            WriteCombiner<TupleT> &wc = *out.combiners[t];
+            result.schedule.run(t, [&](size_t offset, size_t count)
+                                { scatter_write_combined(input + offset, count, bits, wc, reserve, hash); });
+            drain_write_combined(wc, reserve);
+        };
+
+        result.seconds = pool.run([&](uint32_t t)
+                                  {
+            if (out.growable) {
+                // Private chunk chains: grown with plain stores
+                typename ThreadChunkedPartitions<TupleT>::Appender appender(out.chunked, t);
+                scatter_chunk(t, [&](uint32_t p, uint32_t k) { return appender.claim(p, k); });
+                appender.finish();
+                return;
+            }
+
+            uint32_t* write_index = out.counts.data() + static_cast<size_t>(t) * out.partition_count;
+            auto overflow = []() {
+                std::cerr << "Buffer overflow detected!";
+                std::exit(EXIT_FAILURE);
+            };
+
+            // Private slots: no atomics needed
+            if (out.offsets.empty()) {
+                TupleT* buffers = out.storage.get() + static_cast<size_t>(t) * out.partition_count * out.capacity;
+                scatter_chunk(t, [&](uint32_t p, uint32_t k) {
+                    uint32_t idx = write_index[p];
+                    if (idx + k > out.capacity)
+                        overflow();
+                    write_index[p] = idx + k;
+                    return buffers + static_cast<size_t>(p) * out.capacity + idx;
+                });
+                return;
+            }
+
+            const size_t* bounds = out.offsets.data() + static_cast<size_t>(t) * out.partition_count;
+            TupleT* storage = out.storage.get();
+            typename ThreadChunkedPartitions<TupleT>::Appender spill(out.spill, t);
+            scatter_chunk(t, [&](uint32_t p, uint32_t k) {
+                uint32_t idx = write_index[p];
+                if (idx + k > bounds[p + 1] - bounds[p])
+                    return spill.claim(p, k);
+                write_index[p] = idx + k;
+                return storage + bounds[p] + idx;
+            });
+            spill.finish(); });
+        return true;
+    }
+
+private:
+    // Lay out the fixed-capacity buffers: one capacity, or sampled sizes per (thread, partition)
+    template <typename HashFn, typename TupleT>
+    static bool layout_buffers(const TupleT *input, size_t n, uint32_t bits, uint32_t threads,
+                               const PartitionOptions &opts, Output<TupleT> &out, HashFn hash)
+    {
+        out.capacity = overprovisioned_capacity<TupleT>(n / threads / out.partition_count);
+        size_t total_capacity = static_cast<size_t>(threads) * out.partition_count * out.capacity;
+        out.offsets.clear();
+        out.spills = opts.buffers == BufferSizing::Sampled;
+        if (opts.buffers == BufferSizing::Sampled)
+        {
+            SkewProfile profile = sample_skew(input, n, bits, threads, hash);
+            out.offsets.resize(static_cast<size_t>(threads) * out.partition_count + 1);
+            total_capacity = 0;
+            for (uint32_t t = 0; t < threads; ++t)
+            {
+                for (uint32_t p = 0; p < out.partition_count; ++p)
+                {
+                    out.offsets[static_cast<size_t>(t) * out.partition_count + p] = total_capacity;
+                    total_capacity += std::max(out.capacity, sampled_capacity<TupleT>(profile.bound(t, p)));
+                }
+            }
+            out.offsets.back() = total_capacity;
+        }
+        try
+        {
+            reuse_or_allocate(out.storage, total_capacity, opts, threads);
+            out.counts.assign(static_cast<size_t>(threads) * out.partition_count, 0);
+            // One line per spill chunk: each thread's pool starts with one per partition
+            if (out.spills)
+                out.spill.reset(threads, out.partition_count, WriteCombiner<TupleT>::TUPLES_PER_LINE, 0, opts);
+        }
+        catch (const std::bad_alloc &e)
+        {
+            std::cerr << "Memory allocation failed for " << threads << " x " << out.partition_count
+                      << " buffers: " << e.what() << "\n";
+            return false;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <sstream>
+#include <string>
+
+#include "tuple.h"
+#include "workers.h"
+
+/* Key distributions of the generated input.
+   - Uniform:     random 64-bit keys
+   - Zipf:        rank r in [1, domain] with probability ~ r^-skew (skew = theta, any value > 0)
+   - SelfSimilar: Gray et al.'s self-similar distribution, a fraction 1 - skew of the accesses go
+                  to a fraction skew of the domain, recursively (skew = h in (0, 0.5], 0.2 = 80-20)
+   - Sequential:  keys 0, 1, 2, ... in input order
+   - Duplicates:  `domain` distinct keys, drawn uniformly (few keys, many duplicates)
+   Ranks are scrambled by a bijective mix, so hot keys do not share their low bits.
+*/
+enum class KeyDistribution
+{
+    Uniform,
+    Zipf,
+    SelfSimilar,
+    Sequential,
+    Duplicates
+};
+
+struct InputSpec
+{
+    KeyDistribution distribution = KeyDistribution::Uniform;
+    double skew = 1.0;   // Zipf theta or self-similar h
+    uint64_t domain = 0; // distinct keys of Zipf, SelfSimilar and Duplicates; 0: the tuple count (1024 for Duplicates)
+    uint64_t seed = 42;
+};
+
+inline std::string describe_input(const InputSpec &spec)
+{
+    std::ostringstream skew;
+    skew << spec.skew;
+    switch (spec.distribution)
+    {
+    case KeyDistribution::Zipf:
+        return "zipf:" + skew.str();
+    case KeyDistribution::SelfSimilar:
+        return "selfsimilar:" + skew.str();
+    case KeyDistribution::Sequential:
+        return "sequential";
+    case KeyDistribution::Duplicates:
+        return "duplicates:" + std::to_string(spec.domain ? spec.domain : 1024);
+    default:
+        return "uniform";
+    }
+}
+
+// "uniform", "zipf[:theta]", "selfsimilar[:h]", "sequential" or "duplicates[:distinct]"; returns false for anything else
+inline bool parse_input_spec(const std::string &s, InputSpec &spec)
+{
+    size_t colon = s.find(':');
+    std::string name = s.substr(0, colon);
+    std::string param = colon == std::string::npos ? "" : s.substr(colon + 1);
+    try
+    {
+        if (name == "uniform" && param.empty())
+            spec.distribution = KeyDistribution::Uniform;
+        else if (name == "zipf")
+        {
+            spec.distribution = KeyDistribution::Zipf;
+            spec.skew = param.empty() ? 1.0 : std::stod(param);
+            return spec.skew > 0.0;
+        }
+        else if (name == "selfsimilar")
+        {
+            spec.distribution = KeyDistribution::SelfSimilar;
+            spec.skew = param.empty() ? 0.2 : std::stod(param);
+            return spec.skew > 0.0 && spec.skew <= 0.5;
+        }
+        else if (name == "sequential" && param.empty())
+            spec.distribution = KeyDistribution::Sequential;
+        else if (name == "duplicates")
+        {
+            spec.distribution = KeyDistribution::Duplicates;
+            spec.domain = param.empty() ? 1024 : std::stoull(param);
+            return spec.domain > 0;
+        }
+        else
+            return false;
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+    return true;
+}
+
+// Bijective 64-bit mix (splitmix64 finalizer): distinct ranks stay distinct keys
+inline uint64_t scramble_key(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+constexpr uint64_t SPLITMIX_GAMMA = 0x9e3779b97f4a7c15ull;
+
+/* Counter-based random numbers: the i-th output of the SplitMix64 stream seeded with `seed`,
+   computed from i alone. Any range of the input can be generated independently, so the
+   input is the same whichever thread generates which part.
+*/
+inline uint64_t counter_random(uint64_t seed, uint64_t i)
+{
+    return scramble_key(seed + (i + 1) * SPLITMIX_GAMMA);
+}
+
+// Uniform double in [0, 1) from the top 53 bits
+inline double unit_double(uint64_t x)
+{
+    return static_cast<double>(x >> 11) * 0x1.0p-53;
+}
+
+// SplitMix64 stream for a tuple needing several variates (rejection sampling), started from its counter
+struct TupleRng
+{
+    uint64_t state;
+
+    uint64_t operator()()
+    {
+        state += SPLITMIX_GAMMA;
+        return scramble_key(state);
+    }
+};
+
+/* Zipf ranks in [1, n] for any exponent s > 0, by rejection-inversion
+   (Hörmann and Derflinger, "Rejection-inversion to generate variates from monotone discrete
+   distributions"): constant expected time, no table of size n.
+*/
+class ZipfSampler
+{
+public:
+    ZipfSampler(uint64_t n, double s)
+        : n_(n), s_(s), h_integral_x1_(h_integral(1.5) - 1.0), h_integral_n_(h_integral(n + 0.5)),
+          threshold_(2.0 - h_integral_inverse(h_integral(2.5) - h(2.0))) {}
+
+    // rng() returns uniform 64-bit values
+    template <typename Rng>
+    uint64_t operator()(Rng &rng)
+    {
+        for (;;)
+        {
+            double u = h_integral_n_ + unit_double(rng()) * (h_integral_x1_ - h_integral_n_);
+            double x = h_integral_inverse(u);
+            double k = std::floor(x + 0.5);
+            if (k < 1.0)
+                k = 1.0;
+            else if (k > static_cast<double>(n_))
+                k = static_cast<double>(n_);
+            if (k - x <= threshold_ || u >= h_integral(k + 0.5) - h(k))
+                return static_cast<uint64_t>(k);
+        }
+    }
+
+private:
+    double h(double x) const { return std::exp(-s_ * std::log(x)); }
+
+    double h_integral(double x) const
+    {
+        double log_x = std::log(x);
+        return expm1_over_x((1.0 - s_) * log_x) * log_x;
+    }
+
+    double h_integral_inverse(double x) const
+    {
+        double t = x * (1.0 - s_);
+        if (t < -1.0)
+            t = -1.0; // numerical safety
+        return std::exp(log1p_over_x(t) * x);
+    }
+
+    static double expm1_over_x(double x) { return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x / 2.0 * (1.0 + x / 3.0 * (1.0 + x / 4.0)); }
+    static double log1p_over_x(double x) { return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x)); }
+
+    uint64_t n_;
+    double s_;
+    double h_integral_x1_;
+    double h_integral_n_;
+    double threshold_;
+};
+
+/* Tuples [begin, end) of a `count`-tuple input distributed as `spec`, written to out[0, end - begin);
+   every payload word records the tuple's input position
+*/
+template <typename TupleT>
+void generate_range(TupleT *out, uint64_t begin, uint64_t end, uint64_t count, const InputSpec &spec)
+{
+    const uint64_t seed = spec.seed;
+    const uint64_t domain = spec.domain ? spec.domain : (spec.distribution == KeyDistribution::Duplicates ? 1024 : count);
+
+    switch (spec.distribution)
+    {
+    case KeyDistribution::Zipf:
+    {
+        ZipfSampler zipf(domain, spec.skew);
+        for (uint64_t i = begin; i < end; ++i)
+        {
+            TupleRng rng{counter_random(seed, i)};
+            out[i - begin].key = scramble_key(zipf(rng));
+        }
+        break;
+    }
+    case KeyDistribution::SelfSimilar:
+    {
+        const double exponent = std::log(spec.skew) / std::log(1.0 - spec.skew);
+        for (uint64_t i = begin; i < end; ++i)
+        {
+            uint64_t rank = static_cast<uint64_t>(domain * std::pow(unit_double(counter_random(seed, i)), exponent));
+            out[i - begin].key = scramble_key(std::min(rank, domain - 1) + 1);
+        }
+        break;
+    }
+    case KeyDistribution::Sequential:
+        for (uint64_t i = begin; i < end; ++i)
+            out[i - begin].key = i;
+        break;
+    case KeyDistribution::Duplicates:
+        for (uint64_t i = begin; i < end; ++i)
+        {
+            // Multiply-shift maps the 64-bit value onto [0, domain) without a division
+            uint64_t rank = static_cast<uint64_t>((static_cast<unsigned __int128>(counter_random(seed, i)) * domain) >> 64);
+            out[i - begin].key = scramble_key(rank + 1);
+        }
+        break;
+    default:
+        for (uint64_t i = begin; i < end; ++i)
+            out[i - begin].key = counter_random(seed, i);
+        break;
+    }
+    for (uint64_t i = begin; i < end; ++i)
+        set_payload(out[i - begin], i);
+}
+
+// Input with the key distribution of `spec`, generated by the calling thread
+template <typename TupleT>
+void generate_input(TupleT *data, size_t count, const InputSpec &spec)
+{
+    generate_range(data, 0, count, count, spec);
+}
+
+/* Input with the key distribution of `spec`, generated by the workers of `pool`, each writing
+   its static chunk (and so first touching it, as it will read it). Bit-identical to the
+   single-threaded generator for any number of workers.
+*/
+template <typename TupleT>
+void generate_input(TupleT *data, size_t count, const InputSpec &spec, WorkerPool &pool)
+{
+    const uint32_t threads = pool.size();
+    pool.run([&](uint32_t t)
+             {
+        size_t offset, chunk;
+        static_chunk(count, threads, t, offset, chunk);
+        generate_range(data + offset, offset, offset + chunk, count, spec); });
+}
+
+// Uniformly distributed random 64-bit keys
+template <typename TupleT>
+void generate_input(TupleT *data, size_t count, uint64_t seed = 42)
+{
+    InputSpec spec;
+    spec.seed = seed;
+    generate_input(data, count, spec);
+}
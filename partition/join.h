@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "auto_select.h"
+#include "input.h"
+#include "partition.h"
+#include "tuple.h"
+#include "workers.h"
+
+/* Partitioned (radix) hash join: build and probe relations are partitioned with the same
+   strategy and hash, then partition p of the probe side only meets partition p of the build
+   side. Each partition pair is joined by one worker through a bucket-chained hash table over
+   the build partition, small enough to stay in cache. The join counts the matches and sums
+   the payloads of every matching pair instead of materializing them.
+*/
+
+constexpr uint32_t JOIN_MAX_BITS = 24;
+constexpr size_t JOIN_TABLE_BYTES_PER_ROW = 12; // bucket head (up to one per row) + chain link
+
+/* Fewest partition bits that fit a build partition and its table in half the L2 cache
+   (the other half keeps the probe stream and the output cursors)
+*/
+template <typename TupleT = Tuple>
+uint32_t join_bits(size_t build_n)
+{
+    const size_t l2 = cache_bytes(2) ? cache_bytes(2) : 256 << 10;
+    const double bytes = static_cast<double>(build_n) * (sizeof(TupleT) + JOIN_TABLE_BYTES_PER_ROW);
+    uint32_t bits = 0;
+    while (bits < JOIN_MAX_BITS && bytes / (size_t(1) << bits) > l2 / 2)
+        ++bits;
+    return bits;
+}
+
+// Per-worker hash table of one build partition, kept across partitions and runs
+template <typename TupleT>
+struct JoinTable
+{
+    std::vector<TupleT> rows;      // the build partition when it is not one contiguous run
+    std::vector<uint32_t> heads;   // 1 + first row of every bucket, 0 when empty
+    std::vector<uint32_t> next;    // 1 + next row of the same bucket, 0 at the end of a chain
+
+    /* Bucket of `key` among 2^bits: the high bits of key * SPLITMIX_GAMMA, which mix in every
+       key bit, so keys of one partition (sharing their MaskHash bits) still spread
+    */
+    static uint32_t bucket(uint64_t key, uint32_t bits)
+    {
+        return bits == 0 ? 0 : static_cast<uint32_t>((key * SPLITMIX_GAMMA) >> (64 - bits));
+    }
+};
+
+template <typename Strategy, typename TupleT = Tuple>
+struct JoinResult
+{
+    PartitionResult<typename Strategy::template Output<TupleT>> build;
+    PartitionResult<typename Strategy::template Output<TupleT>> probe;
+    std::vector<JoinTable<TupleT>> tables; // one per worker
+    StealingQueue queue;
+    uint64_t matches = 0;
+    uint64_t checksum = 0;      // sum of build and probe payload words over all matching pairs
+    double join_seconds = 0.0;  // building and probing the tables
+    bool ok = false;
+
+    // Timed regions only, like PartitionResult::seconds
+    double seconds() const { return build.seconds + probe.seconds + join_seconds; }
+    double throughput() const { return (build.tuples + probe.tuples) / (seconds() * 1e6); } // MTuple/sec
+};
+
+/* Join partition p of `build` and `probe` into `matches` and `checksum` with `table`.
+   The build partition is used in place when it is one run, copied into the table otherwise.
+*/
+template <typename TupleT, typename Output>
+void join_partition(const Output &build, const Output &probe, uint32_t p, JoinTable<TupleT> &table,
+                    uint64_t &matches, uint64_t &checksum)
+{
+    const size_t n = build.size(p);
+    if (n == 0 || probe.size(p) == 0)
+        return;
+    const TupleT *rows = nullptr;
+    build.for_each_run(p, [&](const TupleT *data, size_t count)
+                       {
+        if (count == n)
+            rows = data; });
+    if (!rows)
+    {
+        table.rows.clear();
+        build.for_each_run(p, [&](const TupleT *data, size_t count)
+                           { table.rows.insert(table.rows.end(), data, data + count); });
+        rows = table.rows.data();
+    }
+
+    const uint32_t bits = std::bit_width(std::bit_ceil(n)) - 1; // at most one row per bucket on average
+    table.heads.assign(size_t(1) << bits, 0);
+    if (table.next.size() < n)
+        table.next.resize(n);
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        uint32_t &head = table.heads[JoinTable<TupleT>::bucket(rows[i].key, bits)];
+        table.next[i] = head;
+        head = i + 1;
+    }
+
+    uint64_t found = 0, sum = 0;
+    probe.for_each_run(p, [&](const TupleT *data, size_t count)
+                       {
+        for (size_t i = 0; i < count; ++i) {
+            const uint64_t key = data[i].key;
+            for (uint32_t e = table.heads[JoinTable<TupleT>::bucket(key, bits)]; e != 0; e = table.next[e - 1]) {
+                if (rows[e - 1].key == key) {
+                    ++found;
+                    sum += payload_word(rows[e - 1]) + payload_word(data[i]);
+                }
+            }
+        } });
+    matches += found;
+    checksum += sum;
+}
+
+/* Join `build` and `probe` with the workers of `pool` into `result`, reusing the partition
+   buffers and tables it already holds: both relations are partitioned into 2^bits partitions
+   by Strategy (MultiPass keeps each pass's fan-out within the TLB for large bits), then the
+   workers join the partition pairs they pop from a work-stealing queue.
+*/
+template <typename Strategy, typename HashFn = MaskHash, typename TupleT = Tuple>
+bool hash_join_into(JoinResult<Strategy, TupleT> &result, const TupleT *build, size_t build_n, const TupleT *probe,
+                    size_t probe_n, uint32_t bits, WorkerPool &pool, const PartitionOptions &opts = {}, HashFn hash = {})
+{
+    const uint32_t threads = pool.size();
+    result.ok = partition_into<Strategy, HashFn>(result.build, build, build_n, bits, pool, opts, hash) &&
+                partition_into<Strategy, HashFn>(result.probe, probe, probe_n, bits, pool, opts, hash);
+    if (!result.ok)
+        return false;
+
+    const auto &build_out = result.build.output;
+    const auto &probe_out = result.probe.output;
+    result.tables.resize(threads);
+    result.queue.reset(build_out.num_partitions(), threads);
+    std::vector<uint64_t> matches(threads * 8, 0), checksums(threads * 8, 0); // a cache line per worker
+
+    result.join_seconds = pool.run([&](uint32_t t)
+                                   {
+        uint64_t found = 0, sum = 0;
+        uint32_t p;
+        while (result.queue.pop(t, p))
+            join_partition(build_out, probe_out, p, result.tables[t], found, sum);
+        matches[t * 8] = found;
+        checksums[t * 8] = sum; });
+
+    result.matches = result.checksum = 0;
+    for (uint32_t t = 0; t < threads; ++t)
+    {
+        result.matches += matches[t * 8];
+        result.checksum += checksums[t * 8];
+    }
+    return true;
+}
+
+// One-off join on a fresh pool of `threads` workers
+template <typename Strategy, typename HashFn = MaskHash, typename TupleT = Tuple>
+JoinResult<Strategy, TupleT> hash_join(const TupleT *build, size_t build_n, const TupleT *probe, size_t probe_n,
+                                       uint32_t bits, uint32_t threads, const PartitionOptions &opts = {}, HashFn hash = {})
+{
+    WorkerPool pool(threads, opts.cores);
+    JoinResult<Strategy, TupleT> result;
+    hash_join_into<Strategy, HashFn>(result, build, build_n, probe, probe_n, bits, pool, opts, hash);
+    return result;
+}
+
+/* Probe relation of a foreign key join against `build`: row i takes the key of build row
+   (k mod build_n), where k is the i-th key drawn from `spec`, so uniform keys probe every build
+   row alike and skewed ones concentrate on a few build rows.
+*/
+template <typename TupleT>
+void generate_probe(TupleT *probe, size_t probe_n, const TupleT *build, size_t build_n, const InputSpec &spec,
+                    WorkerPool &pool)
+{
+    generate_input(probe, probe_n, spec, pool);
+    const uint32_t threads = pool.size();
+    pool.run([&](uint32_t t)
+             {
+        size_t offset, count;
+        static_chunk(probe_n, threads, t, offset, count);
+        for (size_t i = offset; i < offset + count; ++i)
+            probe[i].key = build[probe[i].key % build_n].key; });
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <utility>
+
+constexpr size_t CACHE_LINE_SIZE = 64;       // Bytes
+constexpr size_t PAGE_SIZE = 4096;           // 4KB
+constexpr size_t HUGE_PAGE_2MB = 2ul << 20;  // 2MB
+constexpr size_t HUGE_PAGE_1GB = 1ul << 30;  // 1GB
+
+/* Page backing of large arrays. dTLB misses dominate high fan-out runs, and with 2MB pages
+   one TLB entry covers 512x more memory.
+   - Default:     aligned_alloc, whatever the allocator and THP setting give
+   - Transparent: 2MB-aligned anonymous mapping advised with MADV_HUGEPAGE (THP)
+   - Huge2MB:     explicit hugetlbfs pages, MAP_HUGETLB | MAP_HUGE_2MB
+   - Huge1GB:     explicit hugetlbfs pages, MAP_HUGETLB | MAP_HUGE_1GB
+   Explicit huge pages need pages reserved in /proc/sys/vm/nr_hugepages (or the 1GB pool);
+   when none are available the allocation falls back one step at a time down to Default.
+*/
+enum class PageSize
+{
+    Default,
+    Transparent,
+    Huge2MB,
+    Huge1GB
+};
+
+inline const char *page_size_name(PageSize pages)
+{
+    switch (pages)
+    {
+    case PageSize::Transparent:
+        return "thp";
+    case PageSize::Huge2MB:
+        return "2m";
+    case PageSize::Huge1GB:
+        return "1g";
+    default:
+        return "4k";
+    }
+}
+
+// "4k", "thp", "2m" or "1g"; returns false for anything else
+inline bool parse_page_size(const std::string &s, PageSize &pages)
+{
+    if (s == "4k")
+        pages = PageSize::Default;
+    else if (s == "thp")
+        pages = PageSize::Transparent;
+    else if (s == "2m")
+        pages = PageSize::Huge2MB;
+    else if (s == "1g")
+        pages = PageSize::Huge1GB;
+    else
+        return false;
+    return true;
+}
+
+// Granularity at which memory of the given backing is faulted in
+inline size_t page_bytes(PageSize pages)
+{
+    switch (pages)
+    {
+    case PageSize::Huge2MB:
+        return HUGE_PAGE_2MB;
+    case PageSize::Huge1GB:
+        return HUGE_PAGE_1GB;
+    default:
+        return PAGE_SIZE; // THP may still back a range with 4KB pages
+    }
+}
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+// Anonymous hugetlbfs mapping of `bytes` (a multiple of the page size); nullptr if the pool is empty
+inline void *map_huge_pages(size_t bytes, int huge_flag)
+{
+    void *ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | huge_flag, -1, 0);
+    return ptr == MAP_FAILED ? nullptr : ptr;
+}
+
+// Anonymous mapping aligned to 2MB, so THP can back every 2MB of it with one huge page
+inline void *map_transparent_huge_pages(size_t bytes)
+{
+    size_t span = bytes + HUGE_PAGE_2MB;
+    void *raw = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        return nullptr;
+
+    char *begin = static_cast<char *>(raw);
+    char *aligned = reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(begin) + HUGE_PAGE_2MB - 1) & ~(HUGE_PAGE_2MB - 1));
+    size_t head = aligned - begin;
+    size_t tail = span - head - bytes;
+    if (head)
+        munmap(begin, head);
+    if (tail)
+        munmap(aligned + bytes, tail);
+
+    madvise(aligned, bytes, MADV_HUGEPAGE); // fails harmlessly when THP is disabled
+    return aligned;
+}
+
+/* Touch all pages before running to avoid page faults during measurements.
+   Writing one byte per page forces the OS to back it with physical memory.
+*/
+template <typename T>
+void initialize_memory(T *data, size_t count, size_t step = PAGE_SIZE)
+{
+    char *bytes = reinterpret_cast<char *>(data);
+    size_t size = count * sizeof(T);
+    for (size_t i = 0; i < size; i += step)
+        bytes[i] = 0;
+}
+
+/* Owning, uninitialized array aligned to `alignment` bytes (or to its page size when mapped).
+   The OS reserves the virtual range only; physical pages are allocated when they are
+   first written (touched), so creating a large array is cheap until it is used.
+*/
+template <typename T>
+class AlignedArray
+{
+public:
+    AlignedArray() = default;
+
+    explicit AlignedArray(size_t count, size_t alignment = PAGE_SIZE) : count_(count)
+    {
+        if (count == 0)
+            return;
+        size_t size = (count * sizeof(T) + alignment - 1) / alignment * alignment; // aligned_alloc wants a multiple
+        data_ = static_cast<T *>(aligned_alloc(alignment, size));
+        if (!data_)
+            throw std::bad_alloc();
+    }
+
+    // Backed by the requested page size if possible, else by the next smaller one; see backing()
+    AlignedArray(size_t count, PageSize pages) : count_(count)
+    {
+        if (count == 0)
+            return;
+        size_t bytes = count * sizeof(T);
+
+        if (pages == PageSize::Huge1GB)
+        {
+            size_t size = (bytes + HUGE_PAGE_1GB - 1) & ~(HUGE_PAGE_1GB - 1);
+            if ((data_ = static_cast<T *>(map_huge_pages(size, MAP_HUGE_1GB))))
+            {
+                mapped_bytes_ = size;
+                backing_ = PageSize::Huge1GB;
+                return;
+            }
+            pages = PageSize::Huge2MB;
+        }
+        if (pages == PageSize::Huge2MB)
+        {
+            size_t size = (bytes + HUGE_PAGE_2MB - 1) & ~(HUGE_PAGE_2MB - 1);
+            if ((data_ = static_cast<T *>(map_huge_pages(size, MAP_HUGE_2MB))))
+            {
+                mapped_bytes_ = size;
+                backing_ = PageSize::Huge2MB;
+                return;
+            }
+            pages = PageSize::Transparent;
+        }
+        if (pages == PageSize::Transparent)
+        {
+            size_t size = (bytes + HUGE_PAGE_2MB - 1) & ~(HUGE_PAGE_2MB - 1);
+            if ((data_ = static_cast<T *>(map_transparent_huge_pages(size))))
+            {
+                mapped_bytes_ = size;
+                backing_ = PageSize::Transparent;
+                return;
+            }
+        }
+        *this = AlignedArray(count);
+    }
+
+    ~AlignedArray() { release(); }
+
+    AlignedArray(AlignedArray &&other) noexcept
+        : data_(std::exchange(other.data_, nullptr)), count_(std::exchange(other.count_, 0)),
+          mapped_bytes_(std::exchange(other.mapped_bytes_, 0)), backing_(other.backing_) {}
+
+    AlignedArray &operator=(AlignedArray &&other) noexcept
+    {
+        std::swap(data_, other.data_);
+        std::swap(count_, other.count_);
+        std::swap(mapped_bytes_, other.mapped_bytes_);
+        std::swap(backing_, other.backing_);
+        return *this;
+    }
+
+    AlignedArray(const AlignedArray &) = delete;
+    AlignedArray &operator=(const AlignedArray &) = delete;
+
+    T *get() const { return data_; }
+    size_t size() const { return count_; }
+    T &operator[](size_t i) const { return data_[i]; }
+
+    // Page size actually backing the array
+    PageSize backing() const { return backing_; }
+
+    // Fault in every page now instead of during the measured run
+    void prefault() const { initialize_memory(data_, count_, page_bytes(backing_)); }
+
+private:
+    void release()
+    {
+        if (mapped_bytes_)
+            munmap(data_, mapped_bytes_);
+        else
+            free(data_);
+    }
+
+    T *data_ = nullptr;
+    size_t count_ = 0;
+    size_t mapped_bytes_ = 0; // non-zero: mmap'ed, else aligned_alloc'ed
+    PageSize backing_ = PageSize::Default;
+};
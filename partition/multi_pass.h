@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "count_then_move.h"
+#include "hash.h"
+#include "memory.h"
+#include "options.h"
+#include "scatter.h"
+#include "workers.h"
+
+/* Multi-pass radix partitioning: the b hash bits are split into passes (e.g. 18 = 9+9).
+   Pass 0 partitions the whole input on the most significant group of the b bits, every
+   following pass partitions each sub-partition of the previous pass on the next group.
+   All passes use the same single-pass kernel (histogram + scatter into exact offsets),
+   so partitions stay contiguous and each pass only has 2^bits_per_pass active outputs.
+*/
+struct PassPlan
+{
+    std::vector<uint32_t> bits;  // radix bits handled by each pass
+    std::vector<uint32_t> shift; // lowest hash bit of each pass's radix
+};
+
+// Split b bits into the fewest passes of at most max_bits_per_pass, as evenly as possible
+inline PassPlan plan_passes(uint32_t b, uint32_t max_bits_per_pass)
+{
+    PassPlan plan;
+    uint32_t num_passes = (b + max_bits_per_pass - 1) / max_bits_per_pass;
+    if (num_passes == 0)
+        num_passes = 1;
+    uint32_t remaining = b;
+    for (uint32_t i = 0; i < num_passes; ++i)
+    {
+        uint32_t bits = remaining / (num_passes - i);
+        remaining -= bits;
+        plan.bits.push_back(bits);
+        plan.shift.push_back(remaining);
+    }
+    return plan;
+}
+
+inline std::string describe_plan(const PassPlan &plan)
+{
+    std::string s;
+    for (size_t i = 0; i < plan.bits.size(); ++i)
+    {
+        if (i)
+            s += '+';
+        s += std::to_string(plan.bits[i]);
+    }
+    return s;
+}
+
+struct MultiPass
+{
+    static constexpr const char *name = "multi_pass";
+
+    template <typename TupleT>
+    using Output = ContiguousPartitions<TupleT>;
+
+    template <typename HashFn, typename TupleT>
+    static bool run(const TupleT *input, size_t n, uint32_t bits, WorkerPool &pool,
+                    const PartitionOptions &opts, PartitionResult<Output<TupleT>> &result, HashFn hash = {})
+    {
+        const uint32_t threads = pool.size();
+        const PassPlan plan = plan_passes(bits, opts.max_bits_per_pass);
+        const uint32_t num_passes = static_cast<uint32_t>(plan.bits.size());
+
+        // Passes ping-pong between the output and a scratch array; the result ends in out.data.
+        // Both arrays are kept in the output, so a repeated run reuses them.
+        Output<TupleT> &out = result.output;
+        AlignedArray<TupleT> buffers[2] = {std::move(out.data), std::move(out.scratch)};
+        uint32_t max_fanout = 0; // widest of passes 1..k, the cursors every thread needs
+        for (uint32_t j = 1; j < num_passes; ++j)
+            max_fanout = std::max(max_fanout, 1u << plan.bits[j]);
+        try
+        {
+            reuse_or_allocate(buffers[0], n, opts);
+            if (num_passes > 1)
+                reuse_or_allocate(buffers[1], n, opts);
+            out.cursors.resize(static_cast<size_t>(threads) * max_fanout);
+        }
+        catch (const std::bad_alloc &e)
+        {
+            std::cerr << "Memory allocation failed: " << e.what() << "\n";
+            return false;
+        }
+
+        // starts[j][q]: first tuple of sub-partition q after pass j (2^(bits of passes 0..j) + 1 entries)
+        std::vector<std::vector<uint64_t>> starts(num_passes);
+        uint32_t level_bits = 0;
+        for (uint32_t j = 0; j < num_passes; ++j)
+        {
+            level_bits += plan.bits[j];
+            starts[j].resize((size_t(1) << level_bits) + 1);
+        }
+
+        // Pass 0 is split over the input in morsels like count-then-move
+        const uint32_t fanout0 = 1u << plan.bits[0];
+        std::vector<uint64_t> histograms(static_cast<size_t>(threads) * fanout0, 0);
+        // Later passes hand out whole sub-partitions, one atomic claim each
+        std::vector<std::atomic<uint32_t>> next_subpartition(num_passes);
+        for (auto &c : next_subpartition)
+            c.store(0);
+        SenseBarrier &sync_point = pool.barrier();
+
+        start_schedule(result.schedule, n, threads, opts);
+
+        result.seconds = pool.run([&](uint32_t t)
+                                  {
+            uint64_t* hist = histograms.data() + static_cast<size_t>(t) * fanout0;
+            RadixDigit<HashFn> digit0{bits, plan.shift[0], hash};
+
+            // Pass 0: parallel histogram, prefix sum, scatter into buffers[0]
+            result.schedule.run(t, [&](size_t offset, size_t count) { histogram(input + offset, count, plan.bits[0], hist, digit0); });
+            sync_point.arrive_and_wait();
+            if (t == 0) {
+                uint64_t sum = 0;
+                for (uint32_t p = 0; p < fanout0; ++p) {
+                    starts[0][p] = sum;
+                    for (uint32_t u = 0; u < threads; ++u) {
+                        uint64_t& cell = histograms[static_cast<size_t>(u) * fanout0 + p];
+                        uint64_t c = cell;
+                        cell = sum;
+                        sum += c;
+                    }
+                }
+                starts[0][fanout0] = sum;
+            }
+            sync_point.arrive_and_wait();
+            TupleT* first = buffers[0].get();
+            result.schedule.replay(t, [&](size_t offset, size_t count) {
+                scatter_direct(input + offset, count, plan.bits[0],
+                               [&](uint32_t p, uint32_t) { return first + hist[p]++; }, digit0);
+            });
+
+            // Passes 1..k: each sub-partition of the previous pass is partitioned by one thread
+            uint64_t* cursors = out.cursors.data() + static_cast<size_t>(t) * max_fanout;
+            for (uint32_t j = 1; j < num_passes; ++j) {
+                sync_point.arrive_and_wait();
+                const TupleT* src = buffers[(j - 1) % 2].get();
+                TupleT* dst = buffers[j % 2].get();
+                const uint32_t fanout = 1u << plan.bits[j];
+                const uint32_t num_sub = static_cast<uint32_t>(starts[j - 1].size() - 1);
+                RadixDigit<HashFn> digit{bits, plan.shift[j], hash};
+
+                uint32_t q;
+                while ((q = next_subpartition[j].fetch_add(1, std::memory_order_relaxed)) < num_sub) {
+                    uint64_t begin = starts[j - 1][q];
+                    uint64_t sub_n = starts[j - 1][q + 1] - begin;
+
+                    std::fill(cursors, cursors + fanout, 0);
+                    histogram(src + begin, sub_n, plan.bits[j], cursors, digit);
+                    uint64_t sum = begin;
+                    for (uint32_t p = 0; p < fanout; ++p) {
+                        uint64_t c = cursors[p];
+                        cursors[p] = sum;
+                        starts[j][static_cast<size_t>(q) * fanout + p] = sum;
+                        sum += c;
+                    }
+                    scatter_direct(src + begin, sub_n, plan.bits[j],
+                                   [&](uint32_t p, uint32_t) { return dst + cursors[p]++; }, digit);
+                }
+                if (t == 0)
+                    starts[j][static_cast<size_t>(num_sub) * fanout] = n;
+            } });
+
+        out.data = std::move(buffers[(num_passes - 1) % 2]);
+        out.scratch = std::move(buffers[num_passes % 2]);
+        out.starts = std::move(starts.back());
+        return true;
+    }
+};
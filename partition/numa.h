@@ -0,0 +1,217 @@
+#pragma once
+
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "memory.h"
+#include "workers.h"
+
+/* NUMA placement of the input and output arrays. Without a policy every page lands on the
+   node of the thread that touches it first, which is the main thread for the generated
+   input and the pre-faulted output, so pinned workers on other nodes read and write remotely.
+   - FirstTouch: no policy, the behavior described above
+   - Local:      the input chunk of worker t and the output regions owned by worker t on the
+                 node of cores[t]; output shared by all workers interleaved across nodes
+   - Interleave: every array interleaved page by page across all nodes
+   - Node:       every array on one node (to measure remote access on purpose)
+   Policies are set with raw mbind (MPOL_MF_MOVE migrates pages that were already touched),
+   so no libnuma is needed. Metadata needs no policy: write-combining lines are allocated by
+   the pinned workers themselves, and histograms and cursors are small enough to stay cached.
+*/
+enum class NumaPolicy
+{
+    FirstTouch,
+    Local,
+    Interleave,
+    Node
+};
+
+inline const char *numa_policy_name(NumaPolicy policy)
+{
+    switch (policy)
+    {
+    case NumaPolicy::Local:
+        return "local";
+    case NumaPolicy::Interleave:
+        return "interleave";
+    case NumaPolicy::Node:
+        return "node";
+    default:
+        return "first-touch";
+    }
+}
+
+inline int numa_node_count();
+
+// "first-touch", "local", "interleave" or "node<N>" (e.g. "node1"); returns false for anything else
+inline bool parse_numa_policy(const std::string &s, NumaPolicy &policy, int &node)
+{
+    if (s == "first-touch")
+        policy = NumaPolicy::FirstTouch;
+    else if (s == "local")
+        policy = NumaPolicy::Local;
+    else if (s == "interleave")
+        policy = NumaPolicy::Interleave;
+    else if (s.size() > 4 && s.compare(0, 4, "node") == 0 && s.find_first_not_of("0123456789", 4) == std::string::npos)
+    {
+        if (s.size() > 6 || std::stoi(s.substr(4)) >= numa_node_count())
+            return false; // no such node
+        policy = NumaPolicy::Node;
+        node = std::stoi(s.substr(4));
+    }
+    else
+        return false;
+    return true;
+}
+
+// Highest online node + 1, from /sys/devices/system/node/online ("0", "0-1", "0,2-3")
+inline int numa_node_count()
+{
+    static const int count = []
+    {
+        std::ifstream file("/sys/devices/system/node/online");
+        std::string list;
+        if (!(file >> list))
+            return 1;
+        size_t last = list.find_last_of(",-");
+        return std::stoi(last == std::string::npos ? list : list.substr(last + 1)) + 1;
+    }();
+    return count;
+}
+
+// Node of a PU: the nodeN link in its sysfs directory (0 if there is none)
+inline int numa_node_of_cpu(int cpu)
+{
+    std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/node";
+    for (int node = 0; node < numa_node_count(); ++node)
+    {
+        if (access((dir + std::to_string(node)).c_str(), F_OK) == 0)
+            return node;
+    }
+    return 0;
+}
+
+// Apply an mbind mode over the nodes in `mask` to a page-aligned range; warns once on failure
+inline bool set_memory_policy(void *addr, size_t bytes, int mode, unsigned long mask)
+{
+    if (syscall(SYS_mbind, addr, bytes, mode, &mask, sizeof(mask) * 8, MPOL_MF_MOVE) == 0)
+        return true;
+
+    static bool warned = false;
+    if (!warned)
+    {
+        std::cerr << "mbind failed: " << std::strerror(errno) << "; memory stays where first touched\n";
+        warned = true;
+    }
+    return false;
+}
+
+inline unsigned long all_nodes_mask()
+{
+    int nodes = numa_node_count();
+    return nodes >= 64 ? ~0ul : (1ul << nodes) - 1;
+}
+
+/* Apply `mode` to elements [begin, end) of `array`. The range is rounded to whole pages of the
+   array's backing; a page shared by two ranges goes to the range it starts in.
+*/
+template <typename T>
+bool place_range(const AlignedArray<T> &array, size_t begin, size_t end, int mode, unsigned long mask)
+{
+    const uintptr_t page = page_bytes(array.backing());
+    const uintptr_t base = reinterpret_cast<uintptr_t>(array.get());
+    uintptr_t lo = (base + begin * sizeof(T) + page - 1) & ~(page - 1);
+    uintptr_t hi = (base + end * sizeof(T) + page - 1) & ~(page - 1); // allocations end on a page boundary
+    if (hi <= lo)
+        return true;
+    return set_memory_policy(reinterpret_cast<void *>(lo), hi - lo, mode, mask);
+}
+
+/* Place `array` according to `policy`. With owners > 0 the array is split like the input
+   (static_chunk) into one region per worker, which Local puts on the node of that worker's core.
+   Call before the array is touched; touched pages are migrated, which is slower.
+*/
+template <typename T>
+void place_array(const AlignedArray<T> &array, NumaPolicy policy, int node, uint32_t owners = 0,
+                 const std::vector<int> &cores = {})
+{
+    if (array.size() == 0)
+        return;
+    switch (policy)
+    {
+    case NumaPolicy::Local:
+        if (owners > 0 && !cores.empty())
+        {
+            for (uint32_t t = 0; t < owners; ++t)
+            {
+                size_t offset, count;
+                static_chunk(array.size(), owners, t, offset, count);
+                int owner_node = numa_node_of_cpu(cores[t % cores.size()]);
+                if (!place_range(array, offset, offset + count, MPOL_BIND, 1ul << owner_node))
+                    return;
+            }
+            return;
+        }
+        // Shared by all workers (or workers not pinned): no single owner, spread it
+        place_range(array, 0, array.size(), MPOL_INTERLEAVE, all_nodes_mask());
+        return;
+    case NumaPolicy::Interleave:
+        place_range(array, 0, array.size(), MPOL_INTERLEAVE, all_nodes_mask());
+        return;
+    case NumaPolicy::Node:
+        place_range(array, 0, array.size(), MPOL_BIND, 1ul << node);
+        return;
+    default:
+        return;
+    }
+}
+
+/* Number of resident pages of [ptr, ptr + bytes) on each node, queried with move_pages
+   (no nodes given: it only reports where each page is). Pages not yet touched are not counted.
+*/
+inline std::vector<size_t> pages_per_node(const void *ptr, size_t bytes, size_t page = PAGE_SIZE)
+{
+    std::vector<size_t> counts(numa_node_count(), 0);
+    const uintptr_t base = reinterpret_cast<uintptr_t>(ptr) & ~(page - 1);
+    const uintptr_t end = reinterpret_cast<uintptr_t>(ptr) + bytes;
+    std::vector<void *> pages;
+    for (uintptr_t addr = base; addr < end; addr += page)
+        pages.push_back(reinterpret_cast<void *>(addr));
+
+    std::vector<int> status(pages.size(), -1);
+    if (syscall(SYS_move_pages, 0, pages.size(), pages.data(), nullptr, status.data(), 0) != 0)
+        return counts;
+    for (int s : status)
+    {
+        if (s >= 0 && s < static_cast<int>(counts.size()))
+            counts[s]++;
+    }
+    return counts;
+}
+
+// "node0: 62%, node1: 38%" for the resident pages of `array`
+template <typename T>
+std::string describe_page_nodes(const AlignedArray<T> &array)
+{
+    std::vector<size_t> counts = pages_per_node(array.get(), array.size() * sizeof(T), page_bytes(array.backing()));
+    size_t total = 0;
+    for (size_t c : counts)
+        total += c;
+
+    std::string text;
+    for (size_t node = 0; node < counts.size(); ++node)
+    {
+        if (!text.empty())
+            text += ", ";
+        text += "node" + std::to_string(node) + ": " + std::to_string(total ? counts[node] * 100 / total : 0) + "%";
+    }
+    return text;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "memory.h"
+#include "numa.h"
+#include "workers.h"
+
+// Direct: one store per tuple. WriteCombine: stage 64B lines and stream them out (SWWC).
+enum class ScatterMode
+{
+    Direct,
+    WriteCombine
+};
+
+inline const char *scatter_mode_name(ScatterMode mode)
+{
+    return mode == ScatterMode::WriteCombine ? "swwc" : "direct";
+}
+
+/* How partition buffers are sized.
+   Fixed:    one over-provisioned capacity for the uniform case; skewed input can overflow it
+   Sampled:  capacities from a sample of the input, hot partitions split per thread (skew.h)
+   Growable: chains of pool-allocated chunks that grow on demand (chunked_buffer.h)
+*/
+enum class BufferSizing
+{
+    Fixed,
+    Sampled,
+    Growable
+};
+
+inline const char *buffer_sizing_name(BufferSizing sizing)
+{
+    switch (sizing)
+    {
+    case BufferSizing::Sampled:
+        return "skew-resilient";
+    case BufferSizing::Growable:
+        return "growable";
+    default:
+        return "fixed";
+    }
+}
+
+/* How the input is split among the workers.
+   Static: one equal chunk per worker
+   Morsel: morsels of PartitionOptions::morsel_tuples, own chunk's first, then stolen (MorselSchedule)
+*/
+enum class Schedule
+{
+    Static,
+    Morsel
+};
+
+inline const char *schedule_name(Schedule schedule)
+{
+    return schedule == Schedule::Static ? "static" : "morsel";
+}
+
+// "static" or "morsel"; returns false for anything else
+inline bool parse_schedule(const std::string &s, Schedule &schedule)
+{
+    if (s == "static")
+        schedule = Schedule::Static;
+    else if (s == "morsel")
+        schedule = Schedule::Morsel;
+    else
+        return false;
+    return true;
+}
+
+constexpr size_t MORSEL_TUPLES = 1 << 14; // 256KB of 16B tuples: stealing granularity well above its cost
+
+// Knobs shared by all strategies; strategies ignore the ones that do not apply to them
+struct PartitionOptions
+{
+    ScatterMode scatter = ScatterMode::Direct;
+    std::vector<int> cores;                     // worker t runs on cores[t % cores.size()]; empty: not pinned
+    uint32_t max_bits_per_pass = 9;             // multi-pass: largest fan-out (log2) of a single pass
+    PageSize pages = PageSize::Default;         // page size backing the output arrays
+    bool prefault = true;                       // fault in the output arrays before the timed run
+    NumaPolicy numa = NumaPolicy::FirstTouch;   // placement of the input and output arrays (numa.h)
+    int numa_node = 0;                          // node of NumaPolicy::Node
+    BufferSizing buffers = BufferSizing::Fixed; // concurrent and independent output buffer sizing
+    Schedule schedule = Schedule::Morsel;       // input split among the workers
+    size_t morsel_tuples = MORSEL_TUPLES;       // Schedule::Morsel: tuples per morsel
+};
+
+// NUMA node of every worker's core; empty when the workers are not pinned
+inline std::vector<int> worker_nodes(const PartitionOptions &opts, uint32_t threads)
+{
+    std::vector<int> nodes;
+    if (opts.cores.empty() || numa_node_count() <= 1)
+        return nodes;
+    for (uint32_t t = 0; t < threads; ++t)
+        nodes.push_back(numa_node_of_cpu(opts.cores[t % opts.cores.size()]));
+    return nodes;
+}
+
+/* Prepare `schedule` for a run over n tuples on `threads` workers as `opts` asks.
+   budget: see MorselSchedule::reset
+*/
+inline void start_schedule(MorselSchedule &schedule, size_t n, uint32_t threads, const PartitionOptions &opts,
+                           double budget = 0.0)
+{
+    schedule.reset(n, threads, opts.schedule == Schedule::Static ? 0 : std::max<size_t>(opts.morsel_tuples, 1),
+                   worker_nodes(opts, threads), budget);
+}
+
+/* Output array of a strategy, backed, placed and pre-faulted as `opts` asks.
+   owners > 0: the array is split evenly into regions written by one worker each.
+*/
+template <typename T>
+AlignedArray<T> allocate_output(size_t count, const PartitionOptions &opts, uint32_t owners = 0)
+{
+    AlignedArray<T> array(count, opts.pages);
+    place_array(array, opts.numa, opts.numa_node, owners, opts.cores);
+    if (opts.prefault)
+        array.prefault();
+    return array;
+}
+
+// Keep `array` from a previous run if it is large enough (already placed and faulted in), else allocate it
+template <typename T>
+void reuse_or_allocate(AlignedArray<T> &array, size_t count, const PartitionOptions &opts, uint32_t owners = 0)
+{
+    if (array.size() >= count)
+        return;
+    array = AlignedArray<T>(); // free the old array before allocating the new one
+    array = allocate_output<T>(count, opts, owners);
+}
+
+/* Partitioned output plus the time spent in each phase. Only `seconds`, the time between the
+   workers' start and end barriers, counts toward throughput; setup covers allocation,
+   placement and waking the workers, teardown everything after the end barrier.
+*/
+template <typename Output>
+struct PartitionResult
+{
+    Output output;
+    size_t tuples = 0;
+    double seconds = 0.0;
+    double setup_seconds = 0.0;
+    double teardown_seconds = 0.0;
+    bool ok = false;
+    MorselSchedule schedule; // the input split of the last run; worker_tuples() gives each worker's share
+
+    double throughput() const { return tuples / (seconds * 1e6); } // MTuple/sec
+};
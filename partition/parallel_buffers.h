@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "chunked_buffer.h"
+#include "memory.h"
+#include "options.h"
+#include "scatter.h"
+#include "workers.h"
+
+// Linked list of the chunks holding one partition
+struct ChunkList
+{
+    uint32_t head;
+    uint32_t tail;
+    uint64_t count;
+};
+
+/* Shared slab of fixed-size chunks. Threads claim whole chunks with a single
+   fetch_add and fill them privately, so there is one atomic per chunk instead
+   of one per tuple. Chunks of the same partition are linked through `next`.
+*/
+template <typename TupleT>
+struct ChunkedPartitions
+{
+    AlignedArray<TupleT> data;       // num_chunks * chunk_tuples tuples
+    std::vector<uint32_t> next;      // next chunk of the same partition, NO_CHUNK terminates
+    std::vector<uint32_t> fill;      // tuples stored in each chunk
+    std::vector<ChunkList> lists;    // per partition
+    uint32_t chunk_tuples = 0;
+
+    // Scratch of the workers, [thread][partition], reset before every run and kept for the next
+    std::vector<ChunkList> local_lists; // chunks thread t filled for partition p
+    std::vector<uint32_t> current;      // chunk thread t is filling for partition p
+    std::vector<uint32_t> used;         // its fill level
+
+    uint32_t num_partitions() const { return static_cast<uint32_t>(lists.size()); }
+    size_t size(uint32_t p) const { return lists[p].count; }
+
+    template <typename F>
+    void for_each_run(uint32_t p, F &&f) const
+    {
+        for (uint32_t c = lists[p].head; c != NO_CHUNK; c = next[c])
+            f(static_cast<const TupleT *>(data.get() + static_cast<size_t>(c) * chunk_tuples), static_cast<size_t>(fill[c]));
+    }
+};
+
+// Parallel buffers: chunk-claiming from a shared slab, linked chunk list per partition
+struct ParallelBuffers
+{
+    static constexpr const char *name = "parallel_buffers";
+
+    template <typename TupleT>
+    using Output = ChunkedPartitions<TupleT>;
+
+    template <typename HashFn, typename TupleT>
+    static bool run(const TupleT *input, size_t n, uint32_t bits, WorkerPool &pool,
+                    const PartitionOptions &opts, PartitionResult<Output<TupleT>> &result, HashFn hash = {})
+    {
+        const uint32_t threads = pool.size();
+        Output<TupleT> &out = result.output;
+        const uint32_t num_partitions = 1u << bits;
+        const uint32_t chunk_tuples = choose_chunk_tuples(n, threads, num_partitions);
+        out.chunk_tuples = chunk_tuples;
+
+        // Full chunks for the whole input plus one partial chunk per thread and partition
+        uint64_t chunk_count = (n + chunk_tuples - 1) / chunk_tuples + static_cast<uint64_t>(threads) * num_partitions;
+        if (chunk_count >= NO_CHUNK)
+        {
+            std::cerr << "Too many chunks (" << chunk_count << "). Aborting.\n";
+            return false;
+        }
+        const uint32_t num_chunks = static_cast<uint32_t>(chunk_count);
+        try
+        {
+            reuse_or_allocate(out.data, static_cast<size_t>(num_chunks) * chunk_tuples, opts);
+            out.next.resize(num_chunks);
+            out.fill.resize(num_chunks);
+            out.lists.assign(num_partitions, {NO_CHUNK, NO_CHUNK, 0});
+            const size_t cursors = static_cast<size_t>(threads) * num_partitions;
+            out.local_lists.assign(cursors, {NO_CHUNK, NO_CHUNK, 0});
+            out.current.assign(cursors, NO_CHUNK);
+            out.used.assign(cursors, chunk_tuples);
+        }
+        catch (const std::bad_alloc &e)
+        {
+            std::cerr << "Memory allocation failed for chunk slab: " << e.what() << "\n";
+            return false;
+        }
+
+        alignas(64) std::atomic<uint32_t> next_free{0};
+        const std::vector<ChunkList> &local_lists = out.local_lists;
+        uint32_t partitions_per_thread = (num_partitions + threads - 1) / threads;
+        SenseBarrier &sync_point = pool.barrier();
+
+        start_schedule(result.schedule, n, threads, opts);
+
+        result.seconds = pool.run([&](uint32_t t)
+                                  {
+            const size_t first = static_cast<size_t>(t) * num_partitions;
+            ChunkList* lists = out.local_lists.data() + first;
+
+            // Current chunk and fill level per partition, private to the thread
+            uint32_t* current = out.current.data() + first;
+            uint32_t* used = out.used.data() + first;
+
+            auto reserve = [&](uint32_t p, uint32_t) {
+                if (used[p] == chunk_tuples) {
+                    // Chunk full (or none yet): claim a fresh one, the only atomic in the loop
+                    uint32_t c = next_free.fetch_add(1, std::memory_order_relaxed);
+                    if (c >= num_chunks) {
+                        std::cerr << "Chunk slab exhausted at partition " << p << "\n";
+                        std::abort();
+                    }
+                    if (current[p] != NO_CHUNK) {
+                        out.fill[current[p]] = chunk_tuples;
+                        out.next[current[p]] = c;
+                    } else {
+                        lists[p].head = c;
+                    }
+                    current[p] = c;
+                    used[p] = 0;
+                }
+                return out.data.get() + static_cast<size_t>(current[p]) * chunk_tuples + used[p]++;
+            };
+            result.schedule.run(t, [&](size_t offset, size_t count) { scatter_direct(input + offset, count, bits, reserve, hash); });
+
+            // Seal the partially filled tail chunks
+            for (uint32_t p = 0; p < num_partitions; ++p) {
+                if (current[p] == NO_CHUNK)
+                    continue;
+                out.fill[current[p]] = used[p];
+                out.next[current[p]] = NO_CHUNK;
+                lists[p].tail = current[p];
+            }
+            sync_point.arrive_and_wait();
+
+            // Concatenate the per-thread lists of an owned range of partitions
+            uint32_t p_begin = std::min(num_partitions, t * partitions_per_thread);
+            uint32_t p_end = std::min(num_partitions, p_begin + partitions_per_thread);
+            for (uint32_t p = p_begin; p < p_end; ++p) {
+                ChunkList merged = {NO_CHUNK, NO_CHUNK, 0};
+                for (uint32_t u = 0; u < threads; ++u) {
+                    const ChunkList& part = local_lists[static_cast<size_t>(u) * num_partitions + p];
+                    if (part.head == NO_CHUNK)
+                        continue;
+                    if (merged.tail == NO_CHUNK)
+                        merged.head = part.head;
+                    else
+                        out.next[merged.tail] = part.head;
+                    merged.tail = part.tail;
+                }
+                for (uint32_t c = merged.head; c != NO_CHUNK; c = out.next[c])
+                    merged.count += out.fill[c];
+                out.lists[p] = merged;
+            } });
+        return true;
+    }
+};
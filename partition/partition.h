@@ -0,0 +1,128 @@
+#pragma once
+
+/* libpartition: header-only parallel partitioning.
+
+   auto result = partition<Strategy, HashFn>(input, n, bits, threads, opts);
+
+   or, to reuse the threads and the output buffers across repeated runs,
+
+   WorkerPool pool(threads, opts.cores);
+   PartitionResult<Strategy::Output<TupleT>> result;
+   partition_into<Strategy, HashFn>(result, input, n, bits, pool, opts);
+
+   Strategy is one of ConcurrentOutput, IndependentOutput, CountThenMove, ParallelBuffers
+   or MultiPass. A strategy is a class with
+     - `name`, a printable identifier,
+     - `Output<TupleT>`, its partitioned output type, offering num_partitions(), size(p)
+       and for_each_run(p, f) calling f(const TupleT *data, size_t count) for every
+       contiguous run of partition p,
+     - `run<HashFn>(input, n, bits, pool, opts, result, hash)`, which allocates the output (or
+       reuses the one left in `result` when it fits), partitions the input with one pool.run(...),
+       stores the elapsed partitioning time and returns false on failure.
+   HashFn is a functor from hash.h returning the partition of a key for b bits; `hash` is the
+   instance the kernels call (HashFn{} by default, a RangeHash over its splitter tree for range
+   partitioning, see range_partition.h).
+*/
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <type_traits>
+
+#include "concurrent_output.h"
+#include "count_then_move.h"
+#include "hash.h"
+#include "independent_output.h"
+#include "multi_pass.h"
+#include "options.h"
+#include "parallel_buffers.h"
+#include "tuple.h"
+#include "workers.h"
+
+constexpr uint32_t PARTITION_MAX_BITS = 31; // 2^bits partitions in a uint32_t
+
+/* Most hash bits Strategy takes under `opts`: its MAX_BITS, which bounds fixed-capacity
+   buffers, unless they are growable; PARTITION_MAX_BITS otherwise
+*/
+template <typename Strategy>
+uint32_t max_partition_bits(const PartitionOptions &opts)
+{
+    if constexpr (requires { Strategy::MAX_BITS; })
+    {
+        if (opts.buffers != BufferSizing::Growable)
+            return Strategy::MAX_BITS;
+    }
+    return PARTITION_MAX_BITS;
+}
+
+// Partition with the workers of `pool` into `result`, reusing the output buffers it already holds
+template <typename Strategy, typename HashFn = MaskHash, typename TupleT = Tuple>
+bool partition_into(PartitionResult<typename Strategy::template Output<TupleT>> &result, const TupleT *input,
+                    size_t n, uint32_t bits, WorkerPool &pool, const PartitionOptions &opts = {}, HashFn hash = {})
+{
+    if (bits > max_partition_bits<Strategy>(opts))
+    {
+        std::cerr << "Too many partitions for " << Strategy::name << " (2^" << bits << "). Aborting.\n";
+        result.ok = false;
+        return false;
+    }
+    auto begin = WorkerClock::now();
+    result.tuples = n;
+    result.ok = Strategy::template run<HashFn>(input, n, bits, pool, opts, result, hash);
+    auto end = WorkerClock::now();
+    if (result.ok)
+    {
+        const WorkerRun &run = pool.last_run();
+        result.setup_seconds = std::chrono::duration<double>(run.started - begin).count();
+        result.teardown_seconds = std::chrono::duration<double>(end - run.finished).count();
+    }
+    return result.ok;
+}
+
+// One-off run on a fresh pool of `threads` workers
+template <typename Strategy, typename HashFn = MaskHash, typename TupleT = Tuple>
+PartitionResult<typename Strategy::template Output<TupleT>>
+partition(const TupleT *input, size_t n, uint32_t bits, uint32_t threads, const PartitionOptions &opts = {},
+          HashFn hash = {})
+{
+    WorkerPool pool(threads, opts.cores);
+    PartitionResult<typename Strategy::template Output<TupleT>> result;
+    partition_into<Strategy, HashFn>(result, input, n, bits, pool, opts, hash);
+    return result;
+}
+
+/* Call f(std::type_identity<Strategy>{}) for the strategy named `name` (its `name` member);
+   returns false for an unknown name.
+*/
+template <typename F>
+bool visit_strategy(const std::string &name, F &&f)
+{
+    if (name == ConcurrentOutput::name)
+        f(std::type_identity<ConcurrentOutput>{});
+    else if (name == IndependentOutput::name)
+        f(std::type_identity<IndependentOutput>{});
+    else if (name == CountThenMove::name)
+        f(std::type_identity<CountThenMove>{});
+    else if (name == ParallelBuffers::name)
+        f(std::type_identity<ParallelBuffers>{});
+    else if (name == MultiPass::name)
+        f(std::type_identity<MultiPass>{});
+    else
+        return false;
+    return true;
+}
+
+// Same for the hash functions of hash.h
+template <typename F>
+bool visit_hash(const std::string &name, F &&f)
+{
+    if (name == MaskHash::name)
+        f(std::type_identity<MaskHash>{});
+    else if (name == MultiplicativeHash::name)
+        f(std::type_identity<MultiplicativeHash>{});
+    else
+        return false;
+    return true;
+}
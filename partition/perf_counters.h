@@ -0,0 +1,327 @@
+#pragma once
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "workers.h"
+
+/* Hardware and software counters of the worker threads, read in-process with
+   perf_event_open. Every worker opens one event group for itself; attached to a WorkerPool
+   (pool.observe), the group counts exactly between the start and end barriers of each run,
+   split into the phases between the body's barriers. Events the kernel or the machine does
+   not offer (virtual machines often have no PMU) are left out instead of failing.
+*/
+enum class CounterEvent
+{
+    Cycles,
+    Instructions,
+    L1dMisses,
+    LlcMisses,
+    DtlbMisses,
+    PageFaults,
+    ContextSwitches
+};
+
+constexpr size_t NUM_COUNTER_EVENTS = 7;
+
+inline const char *counter_event_name(CounterEvent event)
+{
+    switch (event)
+    {
+    case CounterEvent::Cycles:
+        return "cycles";
+    case CounterEvent::Instructions:
+        return "instructions";
+    case CounterEvent::L1dMisses:
+        return "l1d_misses";
+    case CounterEvent::LlcMisses:
+        return "llc_misses";
+    case CounterEvent::DtlbMisses:
+        return "dtlb_misses";
+    case CounterEvent::PageFaults:
+        return "page_faults";
+    default:
+        return "context_switches";
+    }
+}
+
+struct CounterValues
+{
+    std::array<double, NUM_COUNTER_EVENTS> values{};
+
+    double operator[](CounterEvent event) const { return values[static_cast<size_t>(event)]; }
+    double &operator[](CounterEvent event) { return values[static_cast<size_t>(event)]; }
+
+    CounterValues &operator+=(const CounterValues &other)
+    {
+        for (size_t e = 0; e < NUM_COUNTER_EVENTS; ++e)
+            values[e] += other.values[e];
+        return *this;
+    }
+};
+
+/* One group of counters on the calling thread, led by the first event that opens.
+   Counts exclude the kernel only where perf_event_paranoid requires it.
+*/
+class PerfGroup
+{
+public:
+    PerfGroup() { fds_.fill(-1); }
+    ~PerfGroup() { close(); }
+
+    PerfGroup(const PerfGroup &) = delete;
+    PerfGroup &operator=(const PerfGroup &) = delete;
+
+    // Open every available event; false if none is
+    bool open()
+    {
+        for (size_t e = 0; e < NUM_COUNTER_EVENTS; ++e)
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            describe(static_cast<CounterEvent>(e), attr);
+            attr.disabled = leader() < 0;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            int fd = perf_event_open(attr);
+            if (fd < 0 && (errno == EACCES || errno == EPERM))
+            {
+                attr.exclude_kernel = 1;
+                fd = perf_event_open(attr);
+            }
+            if (fd < 0)
+                continue;
+            fds_[e] = fd;
+            order_.push_back(static_cast<CounterEvent>(e));
+        }
+        return leader() >= 0;
+    }
+
+    bool available(CounterEvent event) const { return fds_[static_cast<size_t>(event)] >= 0; }
+
+    void reset_and_enable()
+    {
+        ioctl(leader(), PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader(), PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    void disable() { ioctl(leader(), PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP); }
+
+    // Counts since reset_and_enable(), scaled up if the group was multiplexed
+    CounterValues read() const
+    {
+        CounterValues counts;
+        uint64_t buffer[3 + NUM_COUNTER_EVENTS];
+        if (::read(leader(), buffer, sizeof(buffer)) < static_cast<ssize_t>(3 * sizeof(uint64_t)))
+            return counts;
+        const uint64_t enabled = buffer[1], running = buffer[2];
+        const double scale = running > 0 ? static_cast<double>(enabled) / running : 1.0;
+        for (size_t i = 0; i < buffer[0] && i < order_.size(); ++i)
+            counts[order_[i]] = buffer[3 + i] * scale;
+        return counts;
+    }
+
+private:
+    int leader() const { return order_.empty() ? -1 : fds_[static_cast<size_t>(order_.front())]; }
+
+    int perf_event_open(perf_event_attr &attr) const
+    {
+        // pid 0, cpu -1: the calling thread on any CPU
+        return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, leader(), 0));
+    }
+
+    static void describe(CounterEvent event, perf_event_attr &attr)
+    {
+        auto cache_miss = [&attr](uint64_t cache)
+        {
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        };
+        attr.type = PERF_TYPE_HARDWARE;
+        switch (event)
+        {
+        case CounterEvent::Cycles:
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case CounterEvent::Instructions:
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case CounterEvent::L1dMisses:
+            cache_miss(PERF_COUNT_HW_CACHE_L1D);
+            break;
+        case CounterEvent::LlcMisses:
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case CounterEvent::DtlbMisses:
+            cache_miss(PERF_COUNT_HW_CACHE_DTLB);
+            break;
+        case CounterEvent::PageFaults:
+            attr.type = PERF_TYPE_SOFTWARE;
+            attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+            break;
+        case CounterEvent::ContextSwitches:
+            attr.type = PERF_TYPE_SOFTWARE;
+            attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+            break;
+        }
+    }
+
+    void close()
+    {
+        for (int &fd : fds_)
+        {
+            if (fd >= 0)
+                ::close(fd);
+            fd = -1;
+        }
+        order_.clear();
+    }
+
+    std::array<int, NUM_COUNTER_EVENTS> fds_;
+    std::vector<CounterEvent> order_; // read order: leader first
+};
+
+/* Counters of every worker of a pool, summed over the observed runs per thread and phase.
+   Phase k of a run is the stretch before the body's (k+1)-th barrier, the last one ends at
+   the end barrier. The group is enabled right after the start barrier and read and disabled
+   right before the end barrier, so the counts cover the body alone, not the waits at those
+   barriers. Those syscalls and the reads at the barriers inside the body fall in the timed
+   region: they are timed and reported by overhead_seconds() for the benchmark to subtract.
+   The group is opened before the start barrier, outside the timed region.
+*/
+class PerfCounters : public RunObserver
+{
+public:
+    explicit PerfCounters(uint32_t threads) : threads_(threads)
+    {
+        for (uint32_t t = 0; t < threads; ++t)
+            threads_[t] = std::make_unique<ThreadCounters>();
+    }
+
+    static constexpr size_t RESERVED_PHASES = 64; // phases recorded without allocating in the timed region
+
+    void prepare(uint32_t t) override
+    {
+        ThreadCounters &c = *threads_[t];
+        if (!c.opened)
+        {
+            c.opened = true;
+            c.ok = c.group.open();
+            c.phases.reserve(RESERVED_PHASES);
+        }
+    }
+
+    void begin(uint32_t t) override
+    {
+        ThreadCounters &c = *threads_[t];
+        const WorkerClock::time_point start = WorkerClock::now();
+        c.last = {};
+        c.phase = 0;
+        if (c.ok)
+            c.group.reset_and_enable();
+        c.read_seconds = std::chrono::duration<double>(WorkerClock::now() - start).count();
+    }
+
+    void phase(uint32_t t) override
+    {
+        ThreadCounters &c = *threads_[t];
+        const WorkerClock::time_point start = WorkerClock::now();
+        record(c);
+        c.read_seconds += std::chrono::duration<double>(WorkerClock::now() - start).count();
+    }
+
+    void end(uint32_t t) override
+    {
+        ThreadCounters &c = *threads_[t];
+        const WorkerClock::time_point start = WorkerClock::now();
+        record(c);
+        if (c.ok)
+            c.group.disable();
+        c.read_seconds += std::chrono::duration<double>(WorkerClock::now() - start).count();
+        c.runs++;
+    }
+
+    // The workers wait for each other at every barrier: the slowest worker's syscalls delayed the run
+    double overhead_seconds() const override
+    {
+        double seconds = 0.0;
+        for (const auto &c : threads_)
+            seconds = std::max(seconds, c->read_seconds);
+        return seconds;
+    }
+
+    // Whether the workers could count `event` (known once a run was observed)
+    bool available(CounterEvent event) const
+    {
+        for (const auto &c : threads_)
+            if (!c->ok || !c->group.available(event))
+                return false;
+        return !threads_.empty() && threads_[0]->runs > 0;
+    }
+
+    uint32_t threads() const { return static_cast<uint32_t>(threads_.size()); }
+    uint32_t runs() const { return threads_.empty() ? 0 : threads_[0]->runs; }
+
+    // Counts of worker t per phase, summed over the observed runs
+    const std::vector<CounterValues> &phases(uint32_t t) const { return threads_[t]->phases; }
+
+    // All workers and phases, summed over the observed runs
+    CounterValues total() const
+    {
+        CounterValues sum;
+        for (const auto &c : threads_)
+            for (const CounterValues &v : c->phases)
+                sum += v;
+        return sum;
+    }
+
+    // Forget the observed runs
+    void clear()
+    {
+        for (auto &c : threads_)
+        {
+            c->phases.clear();
+            c->runs = 0;
+        }
+    }
+
+private:
+    struct alignas(64) ThreadCounters
+    {
+        PerfGroup group;
+        bool opened = false;
+        bool ok = false;
+        CounterValues last;
+        uint32_t phase = 0;
+        uint32_t runs = 0;
+        double read_seconds = 0.0; // enabling, reading and disabling inside the last run's timed region
+        std::vector<CounterValues> phases;
+    };
+
+    // Close the current phase of a worker: its counts since the previous boundary
+    static void record(ThreadCounters &c)
+    {
+        if (!c.ok)
+            return;
+        CounterValues now = c.group.read();
+        if (c.phases.size() <= c.phase)
+            c.phases.resize(c.phase + 1);
+        for (size_t e = 0; e < NUM_COUNTER_EVENTS; ++e)
+            c.phases[c.phase].values[e] += now.values[e] - c.last.values[e];
+        c.last = now;
+        c.phase++;
+    }
+
+    std::vector<std::unique_ptr<ThreadCounters>> threads_;
+};
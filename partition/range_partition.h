@@ -0,0 +1,240 @@
+#pragma once
+
+#include <immintrin.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "memory.h"
+#include "partition.h"
+#include "skew.h"
+
+// GCC 12 reports the deliberately undefined upper lanes inside its AVX-512 intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+/* Range partitioning: partition p holds the keys between two splitters, so concatenating the
+   partitions in order sorts the input by key range. The splitters are drawn from a sample of
+   the input and searched through a SplitterTree instead of a binary search per tuple:
+
+   - the tree is a static 9-ary search tree, one 64B cache line of 8 separators per node,
+     stored level by level; only the nodes covering real ranges are materialized, so 2^b
+     ranges take about 8 x 2^b bytes (8KB at b = 10, 512KB at b = 16)
+   - one level costs one compare of the key against the whole node (two AVX2 compares or one
+     AVX-512 compare) and a trailing-zero count: the separators are sorted, so the lanes below
+     the key form a prefix and its length is the child to descend to
+   - the search has no data-dependent branches; 4 or 8 keys are searched side by side by the
+     vector overloads of RangeHash, which overlaps their per-level cache misses
+
+   RangeHash plugs the tree into the strategies as a HashFn; it carries state, so it is passed
+   as the `hash` instance of partition_into / partition (range_partition does both steps).
+*/
+
+constexpr uint32_t SPLITTER_NODE_KEYS = 8; // 8B separators per 64B node
+constexpr uint32_t SPLITTER_FANOUT = SPLITTER_NODE_KEYS + 1;
+constexpr size_t SPLITTER_OVERSAMPLING = 64;       // sampled keys per range: ranges within ~1.5x of the mean
+constexpr size_t SPLITTER_MAX_SAMPLES = size_t(1) << 24; // keeps sorting the sample short at 2^20 ranges
+
+class SplitterTree
+{
+public:
+    SplitterTree() = default;
+
+    /* Tree over 2^bits ranges from sorted `splitters`, 2^bits - 1 of them: range r holds the keys
+       in (splitters[r - 1], splitters[r]]. Missing splitters count as the largest key, leaving
+       the last ranges empty.
+    */
+    SplitterTree(uint32_t bits, std::vector<uint64_t> splitters) : bits_(bits), splitters_(std::move(splitters))
+    {
+        const size_t ranges = size_t(1) << bits;
+        splitters_.resize(ranges - 1, std::numeric_limits<uint64_t>::max());
+
+        // Levels so that the leaves (SPLITTER_FANOUT^levels) cover every range
+        size_t leaves = SPLITTER_FANOUT;
+        levels_ = 1;
+        for (; leaves < ranges; leaves *= SPLITTER_FANOUT)
+            levels_++;
+
+        // Level l: nodes covering span leaves each, only those starting below `ranges`
+        std::vector<size_t> level_nodes;
+        size_t total = 0;
+        for (size_t span = leaves; span > 1; span /= SPLITTER_FANOUT)
+        {
+            level_first_.push_back(static_cast<uint32_t>(total));
+            level_nodes.push_back((ranges + span - 1) / span);
+            total += level_nodes.back();
+        }
+        nodes_ = AlignedArray<int64_t>(total * SPLITTER_NODE_KEYS, CACHE_LINE_SIZE);
+
+        // Separator i of node j splits its span into children of span / SPLITTER_FANOUT leaves;
+        // it is the last splitter of child i. Stored with the sign bit flipped, so that the
+        // signed compares of AVX2 order them as unsigned keys.
+        size_t span = leaves;
+        for (uint32_t l = 0; l < levels_; ++l, span /= SPLITTER_FANOUT)
+        {
+            const size_t child = span / SPLITTER_FANOUT;
+            for (size_t j = 0; j < level_nodes[l]; ++j)
+            {
+                int64_t *node = nodes_.get() + (level_first_[l] + j) * SPLITTER_NODE_KEYS;
+                for (uint32_t i = 0; i < SPLITTER_NODE_KEYS; ++i)
+                {
+                    size_t pos = j * span + (i + 1) * child - 1;
+                    node[i] = biased(pos < splitters_.size() ? splitters_[pos] : std::numeric_limits<uint64_t>::max());
+                }
+            }
+        }
+    }
+
+    uint32_t bits() const { return bits_; }
+    uint32_t levels() const { return levels_; }
+    size_t bytes() const { return nodes_.size() * sizeof(int64_t); }
+    const std::vector<uint64_t> &splitters() const { return splitters_; }
+
+    // Range of `key`: the number of splitters below it
+    inline uint32_t find(uint64_t key) const
+    {
+        const int64_t k = biased(key);
+        uint32_t idx = 0;
+        for (uint32_t l = 0; l < levels_; ++l)
+        {
+            const int64_t *node = nodes_.get() + (level_first_[l] + idx) * SPLITTER_NODE_KEYS;
+            uint32_t below = 0;
+            for (uint32_t i = 0; i < SPLITTER_NODE_KEYS; ++i)
+                below += node[i] < k;
+            idx = idx * SPLITTER_FANOUT + below;
+        }
+        return idx;
+    }
+
+    // Ranges of keys[0, 4), searched level by level so that the 4 searches overlap
+    __attribute__((target("avx2"))) inline void find4_avx2(uint64_t *keys) const
+    {
+        __m256i k[4];
+        uint32_t idx[4] = {};
+        for (uint32_t i = 0; i < 4; ++i)
+            k[i] = _mm256_set1_epi64x(biased(keys[i]));
+        for (uint32_t l = 0; l < levels_; ++l)
+        {
+            const int64_t *level = nodes_.get() + size_t(level_first_[l]) * SPLITTER_NODE_KEYS;
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                const __m256i *node = reinterpret_cast<const __m256i *>(level + idx[i] * SPLITTER_NODE_KEYS);
+                __m256i lo = _mm256_cmpgt_epi64(k[i], _mm256_load_si256(node));
+                __m256i hi = _mm256_cmpgt_epi64(k[i], _mm256_load_si256(node + 1));
+                uint32_t mask = _mm256_movemask_pd(_mm256_castsi256_pd(lo)) | _mm256_movemask_pd(_mm256_castsi256_pd(hi)) << 4;
+                idx[i] = idx[i] * SPLITTER_FANOUT + __builtin_ctz(~mask);
+            }
+        }
+        for (uint32_t i = 0; i < 4; ++i)
+            keys[i] = idx[i];
+    }
+
+    // Ranges of keys[0, 8), one compare per node
+    __attribute__((target("avx512f"))) inline void find8_avx512(uint64_t *keys) const
+    {
+        __m512i k[8];
+        uint32_t idx[8] = {};
+        for (uint32_t i = 0; i < 8; ++i)
+            k[i] = _mm512_set1_epi64(biased(keys[i]));
+        for (uint32_t l = 0; l < levels_; ++l)
+        {
+            const int64_t *level = nodes_.get() + size_t(level_first_[l]) * SPLITTER_NODE_KEYS;
+            for (uint32_t i = 0; i < 8; ++i)
+            {
+                uint32_t mask = _mm512_cmpgt_epi64_mask(k[i], _mm512_load_si512(level + idx[i] * SPLITTER_NODE_KEYS));
+                idx[i] = idx[i] * SPLITTER_FANOUT + __builtin_ctz(~mask);
+            }
+        }
+        for (uint32_t i = 0; i < 8; ++i)
+            keys[i] = idx[i];
+    }
+
+private:
+    static int64_t biased(uint64_t key) { return static_cast<int64_t>(key ^ (uint64_t(1) << 63)); }
+
+    uint32_t bits_ = 0;
+    uint32_t levels_ = 0;
+    std::vector<uint64_t> splitters_;
+    std::vector<uint32_t> level_first_; // first node of each level
+    AlignedArray<int64_t> nodes_;
+};
+
+/* Range of a key in `tree` as a HashFn: for b below the tree's bits, 2^(tree bits - b)
+   neighbouring ranges merge into one partition (so multi-pass digits stay ranges too).
+*/
+struct RangeHash
+{
+    static constexpr const char *name = "range";
+
+    const SplitterTree *tree = nullptr;
+
+    inline uint32_t operator()(uint64_t key, uint32_t b) const
+    {
+        return tree->find(key) >> (tree->bits() - b);
+    }
+
+    __attribute__((target("avx2"))) inline __m256i operator()(__m256i keys, uint32_t b) const
+    {
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), keys);
+        tree->find4_avx2(lanes);
+        return _mm256_srl_epi64(_mm256_load_si256(reinterpret_cast<const __m256i *>(lanes)),
+                                _mm_cvtsi32_si128(tree->bits() - b));
+    }
+
+    __attribute__((target("avx512f"))) inline __m512i operator()(__m512i keys, uint32_t b) const
+    {
+        alignas(64) uint64_t lanes[8];
+        _mm512_store_si512(lanes, keys);
+        tree->find8_avx512(lanes);
+        return _mm512_srl_epi64(_mm512_load_si512(lanes), _mm_cvtsi32_si128(tree->bits() - b));
+    }
+};
+
+/* Splitters of 2^bits equally sized ranges, from the sorted keys of a sample of in[0, n):
+   SPLITTER_OVERSAMPLING tuples per range (at most SPLITTER_MAX_SAMPLES), one from each of evenly
+   spaced strata (as sample_skew). Keys repeated more often than a range holds get equal
+   splitters and leave ranges empty; the fixed-capacity outputs assume ranges at most about
+   twice the mean, the counting strategies (count_then_move, multi_pass) have no such limit.
+*/
+template <typename TupleT>
+std::vector<uint64_t> sample_splitters(const TupleT *in, size_t n, uint32_t bits)
+{
+    const size_t ranges = size_t(1) << bits;
+    const size_t samples = std::min({n, SPLITTER_OVERSAMPLING * ranges, SPLITTER_MAX_SAMPLES});
+    std::vector<uint64_t> keys(samples);
+    for (size_t s = 0; s < samples; ++s)
+    {
+        size_t stratum_begin = s * n / samples;
+        size_t stratum_size = (s + 1) * n / samples - stratum_begin;
+        keys[s] = in[stratum_begin + sample_mix(s) % stratum_size].key;
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<uint64_t> splitters(ranges - 1, std::numeric_limits<uint64_t>::max());
+    for (size_t r = 1; r < ranges && samples > 0; ++r)
+        splitters[r - 1] = keys[std::max<size_t>(r * samples / ranges, 1) - 1];
+    return splitters;
+}
+
+template <typename TupleT>
+SplitterTree build_splitter_tree(const TupleT *in, size_t n, uint32_t bits)
+{
+    return SplitterTree(bits, sample_splitters(in, n, bits));
+}
+
+/* One-off range partitioning into 2^bits ranges on a fresh pool of `threads` workers:
+   splitters sampled from the input, then any strategy with RangeHash over them.
+*/
+template <typename Strategy, typename TupleT = Tuple>
+PartitionResult<typename Strategy::template Output<TupleT>>
+range_partition(const TupleT *input, size_t n, uint32_t bits, uint32_t threads, const PartitionOptions &opts = {})
+{
+    const SplitterTree tree = build_splitter_tree(input, n, bits);
+    return partition<Strategy, RangeHash>(input, n, bits, threads, opts, RangeHash{&tree});
+}
+
+#pragma GCC diagnostic pop
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "simd_hash.h"
+#include "write_combining.h"
+
+/* Hot loops shared by all strategies. A strategy only decides where a tuple goes:
+   `reserve(p, k)` returns the destination of the next k tuples of partition p
+   (an atomic claim, a private cursor, a chunk, ...). The loops themselves are common,
+   so an optimization here benefits every strategy.
+   With a SIMD level above scalar, partition ids are hashed in batches of HASH_BATCH
+   by the vector kernels of simd_hash.h before the tuples are moved.
+   The row copies are specialized on the row width at compile time: 8, 16 and 32B rows are
+   plain stores, 64B rows fill a whole line and are streamed (store_row) unless the caller
+   asks for cached stores.
+*/
+
+// Rows of a whole cache line
+template <typename TupleT>
+constexpr bool streams_rows = sizeof(TupleT) == WC_LINE_SIZE;
+
+/* How scatter loops store 64B rows. A locked instruction waits for the streamed stores before
+   it to reach memory, so strategies taking an atomic per row in reserve() ask for Cached.
+*/
+enum class RowStores
+{
+    Streamed,
+    Cached
+};
+
+/* Copy one row. A 64B row overwrites its destination line entirely, so reading the line first
+   (read-for-ownership) would be wasted bandwidth: it is streamed when both ends are line
+   aligned and `stream_line` is set, and the caller fences the streamed stores once done.
+*/
+template <typename TupleT>
+inline void store_row(TupleT *dst, const TupleT *src, StreamLineFn stream_line)
+{
+    if constexpr (streams_rows<TupleT>)
+    {
+        if (stream_line && ((reinterpret_cast<uintptr_t>(dst) | reinterpret_cast<uintptr_t>(src)) & (WC_LINE_SIZE - 1)) == 0)
+        {
+            stream_line(dst, src);
+            return;
+        }
+    }
+    *dst = *src;
+}
+
+// Count the tuples of in[0, n) per partition (hist must hold 2^bits zeroed counters)
+template <typename HashFn, typename TupleT, typename CountT>
+inline void histogram(const TupleT *in, size_t n, uint32_t bits, CountT *hist, HashFn hash = HashFn{})
+{
+    simd_histogram(in, n, bits, hash, hist);
+}
+
+// Whether the scatter loops should precompute partition ids with the vector kernels
+template <typename HashFn, typename TupleT>
+inline bool batch_partition_ids()
+{
+    return simd_hashable<HashFn, TupleT> && active_simd_level() != SimdLevel::Scalar;
+}
+
+// One store per tuple, straight into the slot returned by reserve(p, 1)
+template <typename HashFn, typename TupleT, typename Reserve>
+inline void scatter_direct(const TupleT *in, size_t n, uint32_t bits, Reserve &&reserve, HashFn hash = HashFn{},
+                           RowStores stores = RowStores::Streamed)
+{
+    const StreamLineFn stream_line =
+        streams_rows<TupleT> && stores == RowStores::Streamed ? detect_stream_kernel().stream_line : nullptr;
+    if (batch_partition_ids<HashFn, TupleT>())
+    {
+        alignas(64) uint32_t ids[HASH_BATCH];
+        for (size_t base = 0; base < n; base += HASH_BATCH)
+        {
+            size_t m = std::min(HASH_BATCH, n - base);
+            partition_ids(in + base, m, bits, hash, ids);
+            for (size_t j = 0; j < m; ++j)
+                store_row(reserve(ids[j], 1), in + base + j, stream_line);
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            uint32_t p = hash(in[i].key, bits);
+            store_row(reserve(p, 1), in + i, stream_line);
+        }
+    }
+    if constexpr (streams_rows<TupleT>)
+        _mm_sfence();
+}
+
+/* Software write-combined scatter: full lines are streamed to reserve(p, TUPLES_PER_LINE),
+   which must return 64B-aligned destinations. Partial lines stay in `wc` until drained.
+   64B rows are lines already: they skip the staging and go straight from the input as `stores`.
+*/
+template <typename HashFn, typename TupleT, typename Reserve>
+inline void scatter_write_combined(const TupleT *in, size_t n, uint32_t bits, WriteCombiner<TupleT> &wc,
+                                   Reserve &&reserve, HashFn hash = HashFn{}, RowStores stores = RowStores::Streamed)
+{
+    constexpr uint32_t line_tuples = WriteCombiner<TupleT>::TUPLES_PER_LINE;
+    if constexpr (streams_rows<TupleT>)
+    {
+        scatter_direct(in, n, bits, reserve, hash, stores);
+        return;
+    }
+    if (batch_partition_ids<HashFn, TupleT>())
+    {
+        alignas(64) uint32_t ids[HASH_BATCH];
+        for (size_t base = 0; base < n; base += HASH_BATCH)
+        {
+            size_t m = std::min(HASH_BATCH, n - base);
+            partition_ids(in + base, m, bits, hash, ids);
+            for (size_t j = 0; j < m; ++j)
+            {
+                if (wc.stage(ids[j], in[base + j]))
+                    wc.flush_line(ids[j], reserve(ids[j], line_tuples));
+            }
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        uint32_t p = hash(in[i].key, bits);
+        if (wc.stage(p, in[i]))
+            wc.flush_line(p, reserve(p, line_tuples));
+    }
+}
+
+// Write the partially filled lines left in `wc` with regular stores, then fence the streamed ones
+template <typename TupleT, typename Reserve>
+inline void drain_write_combined(WriteCombiner<TupleT> &wc, Reserve &&reserve)
+{
+    for (uint32_t p = 0; p < wc.num_partitions; ++p)
+    {
+        uint32_t n = wc.pending(p);
+        if (n != 0)
+            wc.flush_partial(p, reserve(p, n));
+    }
+    wc.finish();
+}
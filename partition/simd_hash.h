@@ -0,0 +1,276 @@
+#pragma once
+
+#include <immintrin.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cpu_features.h"
+#include "hash.h"
+
+// GCC 12 reports the deliberately undefined upper lanes inside its AVX-512 intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+/* SIMD partition-id and histogram kernels, dispatched at runtime.
+   - AVX2:    4 keys per hash
+   - AVX-512: 8 keys per hash, histogram with conflict detection (AVX-512CD) + gather/scatter
+   - both:    histogram with replicated counters at low fan-out
+   - scalar:  the plain loops
+   Vector kernels need a VectorHash and rows of 8, 16, 32 or 64B with the key first: bare keys
+   are loaded as they are, 16B rows two per 256-bit load, wider rows gathered key by key.
+   Everything else takes the scalar path.
+*/
+
+enum class SimdLevel
+{
+    Scalar,
+    Avx2,
+    Avx512
+};
+
+inline const char *simd_level_name(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::Avx512:
+        return "avx512";
+    case SimdLevel::Avx2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+inline SimdLevel detect_simd_level()
+{
+    const CpuFeatures &features = cpu_features();
+    if (features.avx512f && features.avx512cd)
+        return SimdLevel::Avx512;
+    if (features.avx2)
+        return SimdLevel::Avx2;
+    return SimdLevel::Scalar;
+}
+
+// Level used by the kernels; detected once, may be lowered (never raised) to compare kernels
+inline SimdLevel &active_simd_level()
+{
+    static SimdLevel level = detect_simd_level();
+    return level;
+}
+
+template <typename HashFn, typename TupleT>
+constexpr bool simd_hashable = VectorHash<HashFn> && sizeof(TupleT) % 8 == 0 && sizeof(TupleT) <= 64 &&
+                                offsetof(TupleT, key) == 0;
+
+constexpr size_t HASH_BATCH = 256;                    // partition ids computed ahead of a scatter
+constexpr uint32_t REPLICATED_HISTOGRAM_MAX_BITS = 10; // 4 counter copies of 2^10 stay in L1
+
+// Partition ids of in[0, n), 4 keys per hash
+template <typename HashFn, typename TupleT>
+__attribute__((target("avx2"))) void partition_ids_avx2(const TupleT *in, size_t n, uint32_t bits, HashFn hash, uint32_t *ids)
+{
+    constexpr long long stride = sizeof(TupleT) / 8; // 64-bit words per row
+    // Hashed lanes come out in input order (16B rows: h0 h2 h1 h3); pick the low dword of each
+    const __m256i order = stride == 2 ? _mm256_setr_epi32(0, 4, 2, 6, 1, 3, 5, 7) : _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    const __m256i rows = _mm256_setr_epi64x(0, stride, 2 * stride, 3 * stride);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i keys;
+        if constexpr (stride == 1)
+            keys = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+        else if constexpr (stride == 2)
+        {
+            const __m256i *src = reinterpret_cast<const __m256i *>(in + i);
+            __m256i a = _mm256_loadu_si256(src);     // k0 p0 k1 p1
+            __m256i b = _mm256_loadu_si256(src + 1); // k2 p2 k3 p3
+            keys = _mm256_unpacklo_epi64(a, b);      // k0 k2 k1 k3
+        }
+        else
+            keys = _mm256_i64gather_epi64(reinterpret_cast<const long long *>(in + i), rows, 8);
+        __m256i h = _mm256_permutevar8x32_epi32(hash(keys, bits), order);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(ids + i), _mm256_castsi256_si128(h));
+    }
+    for (; i < n; ++i)
+        ids[i] = hash(in[i].key, bits);
+}
+
+// 8 hashed keys as 32-bit ids
+template <typename HashFn, typename TupleT>
+__attribute__((target("avx512f,avx512cd"))) inline __m256i hash8_avx512(const TupleT *in, uint32_t bits, HashFn hash)
+{
+    constexpr long long stride = sizeof(TupleT) / 8;
+    __m512i keys;
+    if constexpr (stride == 1)
+        keys = _mm512_loadu_si512(in);
+    else if constexpr (stride == 2)
+    {
+        const __m512i key_lanes = _mm512_setr_epi64(0, 2, 4, 6, 8, 10, 12, 14);
+        __m512i a = _mm512_loadu_si512(in);     // k0 p0 .. k3 p3
+        __m512i b = _mm512_loadu_si512(in + 4); // k4 p4 .. k7 p7
+        keys = _mm512_permutex2var_epi64(a, key_lanes, b);
+    }
+    else
+    {
+        const __m512i rows = _mm512_setr_epi64(0, stride, 2 * stride, 3 * stride, 4 * stride, 5 * stride, 6 * stride, 7 * stride);
+        keys = _mm512_i64gather_epi64(rows, in, 8);
+    }
+    return _mm512_cvtepi64_epi32(hash(keys, bits));
+}
+
+// Partition ids of in[0, n), 8 keys per hash
+template <typename HashFn, typename TupleT>
+__attribute__((target("avx512f,avx512cd"))) void partition_ids_avx512(const TupleT *in, size_t n, uint32_t bits, HashFn hash, uint32_t *ids)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(ids + i), hash8_avx512(in + i, bits, hash));
+    for (; i < n; ++i)
+        ids[i] = hash(in[i].key, bits);
+}
+
+// Partition ids of in[0, n) with the active SIMD level
+template <typename HashFn, typename TupleT>
+inline void partition_ids(const TupleT *in, size_t n, uint32_t bits, HashFn hash, uint32_t *ids)
+{
+    if constexpr (simd_hashable<HashFn, TupleT>)
+    {
+        switch (active_simd_level())
+        {
+        case SimdLevel::Avx512:
+            partition_ids_avx512(in, n, bits, hash, ids);
+            return;
+        case SimdLevel::Avx2:
+            partition_ids_avx2(in, n, bits, hash, ids);
+            return;
+        default:
+            break;
+        }
+    }
+    for (size_t i = 0; i < n; ++i)
+        ids[i] = hash(in[i].key, bits);
+}
+
+/* Histogram over ids hashed in batches by `ids_kernel`. At low fan-out consecutive tuples
+   often hit the same counter, so each of 4 interleaved streams counts into its own replica
+   and the increments no longer wait on each other's stores.
+*/
+template <typename HashFn, typename TupleT, typename CountT, typename IdsKernel>
+void histogram_batched(const TupleT *in, size_t n, uint32_t bits, HashFn hash, CountT *hist, IdsKernel ids_kernel)
+{
+    alignas(64) uint32_t ids[HASH_BATCH];
+    const size_t num_partitions = size_t(1) << bits;
+    if (bits > REPLICATED_HISTOGRAM_MAX_BITS)
+    {
+        for (size_t base = 0; base < n; base += HASH_BATCH)
+        {
+            size_t m = std::min(HASH_BATCH, n - base);
+            ids_kernel(in + base, m, bits, hash, ids);
+            for (size_t j = 0; j < m; ++j)
+                hist[ids[j]]++;
+        }
+        return;
+    }
+
+    std::vector<uint32_t> replicas(4 * num_partitions, 0);
+    uint32_t *r0 = replicas.data(), *r1 = r0 + num_partitions, *r2 = r1 + num_partitions, *r3 = r2 + num_partitions;
+    for (size_t base = 0; base < n; base += HASH_BATCH)
+    {
+        size_t m = std::min(HASH_BATCH, n - base);
+        ids_kernel(in + base, m, bits, hash, ids);
+        size_t j = 0;
+        for (; j + 4 <= m; j += 4)
+        {
+            r0[ids[j]]++;
+            r1[ids[j + 1]]++;
+            r2[ids[j + 2]]++;
+            r3[ids[j + 3]]++;
+        }
+        for (; j < m; ++j)
+            r0[ids[j]]++;
+    }
+    for (size_t p = 0; p < num_partitions; ++p)
+        hist[p] += static_cast<CountT>(r0[p]) + r1[p] + r2[p] + r3[p];
+}
+
+// Per-lane popcount of 32-bit lanes with AVX-512F only (no VPOPCNTDQ)
+__attribute__((target("avx512f"))) inline __m512i popcount_epi32_avx512(__m512i x)
+{
+    x = _mm512_sub_epi32(x, _mm512_and_si512(_mm512_srli_epi32(x, 1), _mm512_set1_epi32(0x55555555)));
+    x = _mm512_add_epi32(_mm512_and_si512(x, _mm512_set1_epi32(0x33333333)),
+                         _mm512_and_si512(_mm512_srli_epi32(x, 2), _mm512_set1_epi32(0x33333333)));
+    x = _mm512_and_si512(_mm512_add_epi32(x, _mm512_srli_epi32(x, 4)), _mm512_set1_epi32(0x0f0f0f0f));
+    return _mm512_srli_epi32(_mm512_mullo_epi32(x, _mm512_set1_epi32(0x01010101)), 24);
+}
+
+/* AVX-512 histogram over 16 ids at a time. vpconflictd marks, per lane, the earlier lanes with
+   the same id, so popcount + 1 is the running count of that id within the vector. Gathering the
+   counters, adding the running counts and scattering back is exact because scatters to the same
+   address retire in lane order: the last occurrence, holding the full count, wins.
+*/
+template <typename HashFn, typename TupleT, typename CountT>
+__attribute__((target("avx512f,avx512cd"))) void histogram_conflict_avx512(const TupleT *in, size_t n, uint32_t bits, HashFn hash, CountT *hist)
+{
+    static_assert(sizeof(CountT) == 4 || sizeof(CountT) == 8, "32 or 64-bit counters");
+    const __m512i one = _mm512_set1_epi32(1);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m512i idx = _mm512_inserti64x4(_mm512_castsi256_si512(hash8_avx512(in + i, bits, hash)),
+                                         hash8_avx512(in + i + 8, bits, hash), 1);
+        __m512i running = _mm512_add_epi32(popcount_epi32_avx512(_mm512_conflict_epi32(idx)), one);
+
+        if constexpr (sizeof(CountT) == 4)
+        {
+            __m512i counts = _mm512_i32gather_epi32(idx, hist, 4);
+            _mm512_i32scatter_epi32(hist, idx, _mm512_add_epi32(counts, running), 4);
+        }
+        else
+        {
+            // Both halves are gathered before either is scattered, and the upper half's running
+            // counts include the lower half's occurrences, so the upper scatter wins correctly
+            __m256i idx_lo = _mm512_castsi512_si256(idx);
+            __m256i idx_hi = _mm512_extracti64x4_epi64(idx, 1);
+            __m512i counts_lo = _mm512_i32gather_epi64(idx_lo, hist, 8);
+            __m512i counts_hi = _mm512_i32gather_epi64(idx_hi, hist, 8);
+            __m512i run_lo = _mm512_cvtepu32_epi64(_mm512_castsi512_si256(running));
+            __m512i run_hi = _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(running, 1));
+            _mm512_i32scatter_epi64(hist, idx_lo, _mm512_add_epi64(counts_lo, run_lo), 8);
+            _mm512_i32scatter_epi64(hist, idx_hi, _mm512_add_epi64(counts_hi, run_hi), 8);
+        }
+    }
+    for (; i < n; ++i)
+        hist[hash(in[i].key, bits)]++;
+}
+
+/* Count the tuples of in[0, n) per partition with the active SIMD level.
+   Replicated counters win while the replicas fit in L1 (b <= REPLICATED_HISTOGRAM_MAX_BITS);
+   above that, AVX-512 uses conflict detection and AVX2 counts batched ids.
+*/
+template <typename HashFn, typename TupleT, typename CountT>
+inline void simd_histogram(const TupleT *in, size_t n, uint32_t bits, HashFn hash, CountT *hist)
+{
+    if constexpr (simd_hashable<HashFn, TupleT>)
+    {
+        switch (active_simd_level())
+        {
+        case SimdLevel::Avx512:
+            if (bits > REPLICATED_HISTOGRAM_MAX_BITS)
+                histogram_conflict_avx512(in, n, bits, hash, hist);
+            else
+                histogram_batched(in, n, bits, hash, hist, partition_ids_avx512<HashFn, TupleT>);
+            return;
+        case SimdLevel::Avx2:
+            histogram_batched(in, n, bits, hash, hist, partition_ids_avx2<HashFn, TupleT>);
+            return;
+        default:
+            break;
+        }
+    }
+    for (size_t i = 0; i < n; ++i)
+        hist[hash(in[i].key, bits)]++;
+}
+
+#pragma GCC diagnostic pop
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "workers.h"
+
+/* Sampling for skew-resilient partitioning (BufferSizing::Sampled).
+   Fixed-capacity strategies size every buffer for the uniform case and overflow under skew.
+   A sample of every worker's input chunk estimates how many tuples each (worker, partition)
+   pair receives; buffers are sized from an upper bound of that estimate (never below the
+   uniform size, which sparse samples can underestimate), and partitions
+   receiving several times their uniform share, or holding a heavy hitter, are marked hot so
+   that strategies sharing a buffer between workers can split them into one sub-buffer per worker.
+   The bounds hold for all buffers at once with probability 1 - SKEW_OVERFLOW_PROBABILITY;
+   strategies spill the rare overflow into chunk chains rather than fail.
+*/
+
+constexpr size_t MIN_SKEW_SAMPLES = 1 << 16;
+constexpr uint32_t SAMPLES_PER_BUFFER = 16;      // expected samples per (worker, partition) when uniform
+constexpr double HOT_PARTITION_FACTOR = 4.0;     // hot: at least 4x the uniform share
+constexpr size_t HEAVY_HITTER_SAMPLES = 1 << 16; // keys counted for heavy-hitter detection
+constexpr double SKEW_OVERFLOW_PROBABILITY = 1e-3; // chance that any buffer of a run exceeds its bound
+
+/* Standard deviations above the estimate for a bound that `buffers` buffers all keep with
+   probability 1 - SKEW_OVERFLOW_PROBABILITY: a union bound over Gaussian tails,
+   P(any) <= buffers * e^(-z^2 / 2)
+*/
+inline double skew_margin(size_t buffers)
+{
+    return std::sqrt(2.0 * std::log(std::max<double>(buffers, 1.0) / SKEW_OVERFLOW_PROBABILITY));
+}
+
+struct SkewProfile
+{
+    uint32_t threads = 0;
+    uint32_t partitions = 0;
+    std::vector<uint32_t> counts;        // [thread][partition] sampled tuples of the thread's chunk
+    std::vector<size_t> chunk_samples;   // [thread] tuples sampled from its chunk
+    std::vector<size_t> chunk_tuples;    // [thread] size of its chunk
+    std::vector<bool> hot;               // [partition]
+    uint32_t hot_count = 0;
+    std::vector<std::pair<uint64_t, double>> heavy_hitters; // keys holding >= 1/partitions of the input, with their share
+
+    // Upper bound on the tuples of partition p in thread t's chunk, over all threads x partitions buffers
+    size_t bound(uint32_t t, uint32_t p) const
+    {
+        return upper_bound(counts[static_cast<size_t>(t) * partitions + p], chunk_samples[t], chunk_tuples[t],
+                           skew_margin(static_cast<size_t>(threads) * partitions));
+    }
+
+    // Upper bound on the tuples of partition p in the whole input, over all partitions
+    size_t bound(uint32_t p) const
+    {
+        size_t c = 0, samples = 0, tuples = 0;
+        for (uint32_t t = 0; t < threads; ++t)
+        {
+            c += counts[static_cast<size_t>(t) * partitions + p];
+            samples += chunk_samples[t];
+            tuples += chunk_tuples[t];
+        }
+        return upper_bound(c, samples, tuples, skew_margin(partitions));
+    }
+
+    /* Upper bound on the tuples of a buffer that got `sampled` of `samples` draws from `tuples`:
+       the upper end of the Wilson interval z sigma above the sampled count, which stays
+       above zero for buffers the sample missed
+    */
+    static size_t upper_bound(size_t sampled, size_t samples, size_t tuples, double z)
+    {
+        if (samples == 0)
+            return 0;
+        if (samples >= tuples)
+            return sampled; // the whole chunk was counted
+        double c = static_cast<double>(sampled);
+        double estimate = (c + z * z / 2 + z * std::sqrt(c + z * z / 4)) * tuples / samples;
+        return std::min(tuples, static_cast<size_t>(std::ceil(estimate)));
+    }
+};
+
+// Deterministic jitter for sample positions (splitmix64 finalizer)
+inline uint64_t sample_mix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/* Sample every worker's static chunk of in[0, n): one tuple from each of evenly spaced strata,
+   at a pseudo-random position inside the stratum, so periodic inputs are not aliased.
+   Chunks smaller than their sample budget are counted exactly.
+*/
+template <typename HashFn, typename TupleT>
+SkewProfile sample_skew(const TupleT *in, size_t n, uint32_t bits, uint32_t threads, HashFn hash = HashFn{})
+{
+    SkewProfile profile;
+    profile.threads = threads;
+    profile.partitions = 1u << bits;
+    profile.counts.assign(static_cast<size_t>(threads) * profile.partitions, 0);
+    profile.chunk_samples.assign(threads, 0);
+    profile.chunk_tuples.assign(threads, 0);
+
+    const size_t budget = std::max<size_t>(MIN_SKEW_SAMPLES, static_cast<size_t>(SAMPLES_PER_BUFFER) * threads * profile.partitions);
+    std::vector<uint64_t> keys;
+    for (uint32_t t = 0; t < threads; ++t)
+    {
+        size_t offset, count;
+        static_chunk(n, threads, t, offset, count);
+        profile.chunk_tuples[t] = count;
+        if (count == 0)
+            continue;
+        size_t samples = std::min(count, budget / threads + 1);
+        uint32_t *hist = profile.counts.data() + static_cast<size_t>(t) * profile.partitions;
+        size_t key_stride = std::max<size_t>(1, samples * threads / HEAVY_HITTER_SAMPLES);
+        for (size_t s = 0; s < samples; ++s)
+        {
+            size_t stratum_begin = s * count / samples;
+            size_t stratum_size = (s + 1) * count / samples - stratum_begin;
+            const TupleT &tuple = in[offset + stratum_begin + sample_mix(offset + s) % stratum_size];
+            hist[hash(tuple.key, bits)]++;
+            if (s % key_stride == 0)
+                keys.push_back(tuple.key);
+        }
+        profile.chunk_samples[t] = samples;
+    }
+
+    // Heavy hitters: single keys worth at least a whole average partition, from the key subsample
+    std::unordered_map<uint64_t, uint32_t> frequency;
+    for (uint64_t key : keys)
+        frequency[key]++;
+    for (const auto &[key, f] : frequency)
+    {
+        double share = static_cast<double>(f) / keys.size();
+        if (share * profile.partitions >= 1.0 && f >= 4)
+            profile.heavy_hitters.emplace_back(key, share);
+    }
+    std::sort(profile.heavy_hitters.begin(), profile.heavy_hitters.end(),
+              [](const auto &a, const auto &b)
+              { return a.second > b.second; });
+
+    // Hot partitions, from the pooled counts; a heavy hitter's partition is hot whatever else it holds
+    size_t total_samples = 0;
+    for (size_t s : profile.chunk_samples)
+        total_samples += s;
+    profile.hot.assign(profile.partitions, false);
+    for (uint32_t p = 0; p < profile.partitions && threads > 1; ++p)
+    {
+        size_t c = 0;
+        for (uint32_t t = 0; t < threads; ++t)
+            c += profile.counts[static_cast<size_t>(t) * profile.partitions + p];
+        if (c >= HOT_PARTITION_FACTOR * total_samples / profile.partitions && c >= SAMPLES_PER_BUFFER)
+            profile.hot[p] = true;
+    }
+    for (const auto &hitter : profile.heavy_hitters)
+    {
+        if (threads > 1)
+            profile.hot[hash(hitter.first, bits)] = true;
+    }
+    profile.hot_count = static_cast<uint32_t>(std::count(profile.hot.begin(), profile.hot.end(), true));
+    return profile;
+}
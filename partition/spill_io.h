@@ -0,0 +1,381 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Asynchronous writes for spill files. A writer takes (fd, buffer, offset) requests and
+   completes them in the background, so the threads producing the data keep partitioning:
+   - Uring:   io_uring through raw syscalls (no liburing), one completion thread
+   - Threads: a pool of threads calling pwrite
+   - Sync:    pwrite in the submitting thread
+*/
+enum class SpillIo
+{
+    Sync,
+    Threads,
+    Uring
+};
+
+inline const char *spill_io_name(SpillIo io)
+{
+    switch (io)
+    {
+    case SpillIo::Threads:
+        return "threads";
+    case SpillIo::Uring:
+        return "io_uring";
+    default:
+        return "sync";
+    }
+}
+
+// "sync", "threads" or "uring"; returns false for anything else
+inline bool parse_spill_io(const std::string &s, SpillIo &io)
+{
+    if (s == "sync")
+        io = SpillIo::Sync;
+    else if (s == "threads")
+        io = SpillIo::Threads;
+    else if (s == "uring")
+        io = SpillIo::Uring;
+    else
+        return false;
+    return true;
+}
+
+struct SpillOptions
+{
+    SpillIo io = SpillIo::Uring;  // falls back to Threads where io_uring is unavailable
+    bool direct = false;          // O_DIRECT spill files (bypass the page cache)
+    uint32_t io_threads = 4;      // Threads: number of pwrite threads
+    uint32_t queue_depth = 64;    // writes in flight at most
+};
+
+// Write all `bytes` at `offset`, retrying short writes
+inline bool write_fully(int fd, const void *buf, size_t bytes, uint64_t offset)
+{
+    size_t done = 0;
+    while (done < bytes)
+    {
+        ssize_t w = pwrite(fd, static_cast<const char *>(buf) + done, bytes - done, static_cast<off_t>(offset + done));
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            return false;
+        done += static_cast<size_t>(w);
+    }
+    return true;
+}
+
+// One write; the buffer must stay untouched until done
+struct WriteRequest
+{
+    int fd = -1;
+    const void *buf = nullptr;
+    size_t bytes = 0;
+    uint64_t offset = 0;
+    bool done = true;
+    int error = 0; // errno of a failed write
+};
+
+/* The submission and completion rings of an io_uring instance, mapped from the kernel.
+   Only IORING_OP_WRITE is used; user_data carries the WriteRequest.
+*/
+class IoUring
+{
+public:
+    IoUring() = default;
+    ~IoUring() { close(); }
+
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+
+    bool init(unsigned entries)
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0)
+            return false;
+
+        sq_bytes_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_bytes_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        sqes_bytes_ = params.sq_entries * sizeof(io_uring_sqe);
+        sq_ = map(sq_bytes_, IORING_OFF_SQ_RING);
+        cq_ = map(cq_bytes_, IORING_OFF_CQ_RING);
+        sqes_ = static_cast<io_uring_sqe *>(map(sqes_bytes_, IORING_OFF_SQES));
+        if (!sq_ || !cq_ || !sqes_)
+        {
+            close();
+            return false;
+        }
+
+        char *sq = static_cast<char *>(sq_);
+        char *cq = static_cast<char *>(cq_);
+        sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    // Queue and submit one write (the caller keeps at most `entries` in flight)
+    bool submit_write(WriteRequest *r)
+    {
+        unsigned tail = *sq_tail_;
+        unsigned index = tail & sq_mask_;
+        io_uring_sqe &sqe = sqes_[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_WRITE;
+        sqe.fd = r->fd;
+        sqe.addr = reinterpret_cast<uint64_t>(r->buf);
+        sqe.len = static_cast<uint32_t>(r->bytes);
+        sqe.off = r->offset;
+        sqe.user_data = reinterpret_cast<uint64_t>(r);
+        sq_array_[index] = index;
+        std::atomic_ref<unsigned>(*sq_tail_).store(tail + 1, std::memory_order_release);
+        return enter(1, 0, 0) >= 0;
+    }
+
+    // Block until at least one completion is available
+    bool wait() { return enter(0, 1, IORING_ENTER_GETEVENTS) >= 0; }
+
+    // Hand every available completion to f(request, result)
+    template <typename F>
+    unsigned reap(F &&f)
+    {
+        unsigned head = *cq_head_;
+        unsigned tail = std::atomic_ref<unsigned>(*cq_tail_).load(std::memory_order_acquire);
+        unsigned count = tail - head;
+        for (; head != tail; ++head)
+        {
+            const io_uring_cqe &cqe = cqes_[head & cq_mask_];
+            f(reinterpret_cast<WriteRequest *>(cqe.user_data), cqe.res);
+        }
+        std::atomic_ref<unsigned>(*cq_head_).store(head, std::memory_order_release);
+        return count;
+    }
+
+private:
+    void *map(size_t bytes, uint64_t offset)
+    {
+        void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, static_cast<off_t>(offset));
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags)
+    {
+        for (;;)
+        {
+            int r = static_cast<int>(syscall(__NR_io_uring_enter, fd_, to_submit, min_complete, flags, nullptr, 0));
+            if (r >= 0 || errno != EINTR)
+                return r;
+        }
+    }
+
+    void close()
+    {
+        if (sqes_)
+            munmap(sqes_, sqes_bytes_);
+        if (cq_)
+            munmap(cq_, cq_bytes_);
+        if (sq_)
+            munmap(sq_, sq_bytes_);
+        if (fd_ >= 0)
+            ::close(fd_);
+        sqes_ = nullptr;
+        cq_ = sq_ = nullptr;
+        fd_ = -1;
+    }
+
+    int fd_ = -1;
+    void *sq_ = nullptr;
+    void *cq_ = nullptr;
+    io_uring_sqe *sqes_ = nullptr;
+    size_t sq_bytes_ = 0, cq_bytes_ = 0, sqes_bytes_ = 0;
+    unsigned *sq_tail_ = nullptr, *sq_array_ = nullptr, *cq_head_ = nullptr, *cq_tail_ = nullptr;
+    unsigned sq_mask_ = 0, cq_mask_ = 0;
+    io_uring_cqe *cqes_ = nullptr;
+};
+
+/* Background writer shared by all spill files. submit() returns at once (after waiting for a
+   free slot when queue_depth writes are in flight); wait() blocks until a request is done.
+   With io_uring, submitters fill the ring under a mutex and one completion thread reaps it;
+   with threads, the pool pops requests from a queue. Written bytes are counted for bandwidth.
+*/
+class AsyncWriter
+{
+public:
+    explicit AsyncWriter(const SpillOptions &opts = {}) : io_(opts.io), depth_(std::max(1u, opts.queue_depth))
+    {
+        if (io_ == SpillIo::Uring)
+        {
+            if (ring_.init(depth_))
+                workers_.emplace_back([this]
+                                      { complete_uring(); });
+            else
+            {
+                std::cerr << "io_uring unavailable (" << std::strerror(errno) << "), using a pwrite thread pool\n";
+                io_ = SpillIo::Threads;
+            }
+        }
+        if (io_ == SpillIo::Threads)
+            for (uint32_t i = 0; i < std::max(1u, opts.io_threads); ++i)
+                workers_.emplace_back([this]
+                                      { write_queued(); });
+    }
+
+    ~AsyncWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        work_.notify_all();
+        for (auto &w : workers_)
+            w.join();
+    }
+
+    AsyncWriter(const AsyncWriter &) = delete;
+    AsyncWriter &operator=(const AsyncWriter &) = delete;
+
+    // Backend actually in use
+    SpillIo backend() const { return io_; }
+
+    void submit(WriteRequest &r, int fd, const void *buf, size_t bytes, uint64_t offset)
+    {
+        r = {fd, buf, bytes, offset, false, 0};
+        if (io_ == SpillIo::Sync)
+        {
+            finish(&r, write_fully(fd, buf, bytes, offset) ? 0 : errno);
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]
+                   { return in_flight_ < depth_; });
+        in_flight_++;
+        if (io_ == SpillIo::Threads)
+            queue_.push_back(&r);
+        else if (!ring_.submit_write(&r))
+        {
+            in_flight_--;
+            lock.unlock();
+            finish(&r, errno);
+            return;
+        }
+        lock.unlock();
+        work_.notify_one();
+    }
+
+    void wait(WriteRequest &r)
+    {
+        if (io_ == SpillIo::Sync)
+            return;
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [&r]
+                   { return r.done; });
+    }
+
+    uint64_t bytes_written() const { return bytes_written_.load(std::memory_order_relaxed); }
+
+private:
+    void finish(WriteRequest *r, int error)
+    {
+        if (error == 0)
+            bytes_written_.fetch_add(r->bytes, std::memory_order_relaxed);
+        if (io_ == SpillIo::Sync)
+        {
+            r->error = error;
+            r->done = true;
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            r->error = error;
+            r->done = true;
+        }
+        done_.notify_all();
+    }
+
+    // Thread pool: pwrite queued requests until stopped and drained
+    void write_queued()
+    {
+        for (;;)
+        {
+            WriteRequest *r;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                work_.wait(lock, [this]
+                           { return stop_ || !queue_.empty(); });
+                if (queue_.empty())
+                    return;
+                r = queue_.front();
+                queue_.pop_front();
+            }
+            int error = write_fully(r->fd, r->buf, r->bytes, r->offset) ? 0 : errno;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                in_flight_--;
+            }
+            finish(r, error);
+        }
+    }
+
+    // io_uring: reap completions while writes are in flight; short writes are finished with pwrite
+    void complete_uring()
+    {
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                work_.wait(lock, [this]
+                           { return stop_ || in_flight_ > 0; });
+                if (in_flight_ == 0)
+                    return;
+            }
+            ring_.wait();
+            ring_.reap([this](WriteRequest *r, int res)
+                       {
+                int error = res < 0 ? -res : 0;
+                size_t written = res < 0 ? 0 : static_cast<size_t>(res);
+                if (error == 0 && written < r->bytes &&
+                    !write_fully(r->fd, static_cast<const char *>(r->buf) + written, r->bytes - written, r->offset + written))
+                    error = errno;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    in_flight_--;
+                }
+                finish(r, error); });
+        }
+    }
+
+    SpillIo io_;
+    const uint32_t depth_;
+    IoUring ring_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable work_;
+    std::condition_variable done_;
+    std::deque<WriteRequest *> queue_;
+    uint32_t in_flight_ = 0;
+    bool stop_ = false;
+    std::atomic<uint64_t> bytes_written_{0};
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <numeric>
+#include <vector>
+
+/* Summary statistics of repeated measurements. Percentiles interpolate linearly between
+   order statistics; the confidence interval is the two-sided 95% Student-t interval of the
+   mean, so it stays honest for the handful of repeats a benchmark can afford.
+*/
+struct Summary
+{
+    size_t count = 0;
+    double mean = 0.0;
+    double stddev = 0.0; // sample standard deviation (n - 1)
+    double min = 0.0;
+    double p5 = 0.0;
+    double median = 0.0;
+    double p95 = 0.0;
+    double max = 0.0;
+    double ci95_low = 0.0;
+    double ci95_high = 0.0;
+};
+
+// Two-sided 97.5% quantile of Student's t with `df` degrees of freedom
+inline double student_t_975(size_t df)
+{
+    static constexpr double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                       2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                       2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (df == 0)
+        return 0.0;
+    if (df <= std::size(table))
+        return table[df - 1];
+    return df <= 60 ? 2.000 : df <= 120 ? 1.980 : 1.960;
+}
+
+// Percentile q in [0, 1] of ascending `sorted`
+inline double percentile(const std::vector<double> &sorted, double q)
+{
+    if (sorted.empty())
+        return 0.0;
+    double rank = q * (sorted.size() - 1);
+    size_t below = static_cast<size_t>(rank);
+    size_t above = std::min(below + 1, sorted.size() - 1);
+    return sorted[below] + (rank - below) * (sorted[above] - sorted[below]);
+}
+
+inline Summary summarize(std::vector<double> samples)
+{
+    Summary s;
+    s.count = samples.size();
+    if (samples.empty())
+        return s;
+    std::sort(samples.begin(), samples.end());
+    s.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / s.count;
+    double squares = 0.0;
+    for (double x : samples)
+        squares += (x - s.mean) * (x - s.mean);
+    s.stddev = s.count > 1 ? std::sqrt(squares / (s.count - 1)) : 0.0;
+    s.min = samples.front();
+    s.max = samples.back();
+    s.p5 = percentile(samples, 0.05);
+    s.median = percentile(samples, 0.5);
+    s.p95 = percentile(samples, 0.95);
+    double half_width = student_t_975(s.count - 1) * s.stddev / std::sqrt(static_cast<double>(s.count));
+    s.ci95_low = s.mean - half_width;
+    s.ci95_high = s.mean + half_width;
+    return s;
+}
@@ -0,0 +1,377 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "input.h"
+#include "memory.h"
+#include "options.h"
+#include "partition.h"
+#include "spill_io.h"
+#include "workers.h"
+
+/* Out-of-core partitioning: the input is a file of raw tuples, possibly larger than memory,
+   and every partition ends up in its own spill file. Only two input blocks and one staging
+   buffer per partition are held in memory; tuple counts and file offsets are 64-bit.
+*/
+
+constexpr size_t STREAM_BLOCK_BYTES = 256ull << 20;   // input read (and partitioned) at once
+constexpr size_t SPILL_BUFFER_BUDGET = 256ull << 20;  // staging memory shared by all partitions
+constexpr size_t MAX_SPILL_BUFFER_BYTES = 4ull << 20; // largest single spill write
+
+// Read `bytes` at `offset`, retrying short reads; returns the bytes read (less at end of file) or -1
+inline ssize_t read_fully(int fd, void *buf, size_t bytes, uint64_t offset)
+{
+    size_t done = 0;
+    while (done < bytes)
+    {
+        ssize_t r = pread(fd, static_cast<char *>(buf) + done, bytes - done, static_cast<off_t>(offset + done));
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0)
+            return -1;
+        if (r == 0)
+            break;
+        done += static_cast<size_t>(r);
+    }
+    return static_cast<ssize_t>(done);
+}
+
+/* Spill file of one partition. Appended runs are staged in two page-aligned buffers: when
+   one fills it is handed to the AsyncWriter and appends continue in the other, so a flush
+   overlaps with the partitioning that follows; a buffer is only waited for when it is
+   needed again. The file thus sees large, aligned writes, which also lets it be opened with
+   O_DIRECT: the last, partial buffer is then padded to a page and the file truncated back.
+*/
+template <typename TupleT>
+class SpillFile
+{
+public:
+    SpillFile() = default;
+    ~SpillFile() { close(); }
+
+    SpillFile(const SpillFile &) = delete;
+    SpillFile &operator=(const SpillFile &) = delete;
+
+    // Falls back to buffered I/O when the file system refuses O_DIRECT (see direct())
+    bool open(const std::string &path, size_t buffer_tuples, AsyncWriter &writer, bool direct = false)
+    {
+        const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+        fd_ = ::open(path.c_str(), flags | (direct ? O_DIRECT : 0), 0644);
+        direct_ = direct && fd_ >= 0;
+        if (fd_ < 0 && direct && errno == EINVAL)
+            fd_ = ::open(path.c_str(), flags, 0644);
+        if (fd_ < 0)
+            return false;
+        writer_ = &writer;
+        for (auto &buffer : buffers_)
+            buffer = AlignedArray<TupleT>(buffer_tuples, PAGE_SIZE);
+        current_ = 0;
+        fill_ = 0;
+        written_ = 0;
+        return true;
+    }
+
+    bool append(const TupleT *data, size_t count)
+    {
+        while (count > 0)
+        {
+            AlignedArray<TupleT> &buffer = buffers_[current_];
+            size_t n = std::min(count, buffer.size() - fill_);
+            std::memcpy(buffer.get() + fill_, data, n * sizeof(TupleT));
+            fill_ += n;
+            data += n;
+            count -= n;
+            if (fill_ == buffer.size() && !flush(fill_ * sizeof(TupleT)))
+                return false;
+        }
+        return true;
+    }
+
+    // Write what is left in the staging buffer and wait for every write of the file
+    bool finish()
+    {
+        const uint64_t bytes = tuples() * sizeof(TupleT);
+        if (fill_ > 0)
+        {
+            size_t size = fill_ * sizeof(TupleT);
+            if (direct_)
+            {
+                size_t padded = (size + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+                std::memset(reinterpret_cast<char *>(buffers_[current_].get()) + size, 0, padded - size);
+                size = padded;
+            }
+            if (!flush(size))
+                return false;
+        }
+        if (!wait(requests_[0]) || !wait(requests_[1]))
+            return false;
+        return !direct_ || ftruncate(fd_, static_cast<off_t>(bytes)) == 0;
+    }
+
+    void close()
+    {
+        if (writer_)
+            for (auto &r : requests_)
+                writer_->wait(r);
+        if (fd_ >= 0)
+            ::close(fd_);
+        fd_ = -1;
+    }
+
+    uint64_t tuples() const { return written_ + fill_; }
+    bool direct() const { return direct_; }
+
+private:
+    // Submit the current buffer (`bytes` of it), switch to the other one and wait until it is free
+    bool flush(size_t bytes)
+    {
+        writer_->submit(requests_[current_], fd_, buffers_[current_].get(), bytes, written_ * sizeof(TupleT));
+        written_ += fill_;
+        fill_ = 0;
+        current_ ^= 1;
+        return wait(requests_[current_]);
+    }
+
+    // Wait for a write; errno is set to its error if it failed
+    bool wait(WriteRequest &r)
+    {
+        writer_->wait(r);
+        if (r.error == 0)
+            return true;
+        errno = r.error;
+        return false;
+    }
+
+    int fd_ = -1;
+    bool direct_ = false;
+    AsyncWriter *writer_ = nullptr;
+    AlignedArray<TupleT> buffers_[2];
+    WriteRequest requests_[2];
+    uint32_t current_ = 0; // buffer being filled
+    size_t fill_ = 0;
+    uint64_t written_ = 0; // tuples submitted to the file
+};
+
+// Each of a partition's two staging buffers: the budget split evenly, in whole pages, within [1 page, 4MB]
+template <typename TupleT>
+inline size_t spill_buffer_tuples(uint32_t num_partitions)
+{
+    static_assert(PAGE_SIZE % sizeof(TupleT) == 0, "tuples must not straddle pages");
+    size_t bytes = std::clamp(SPILL_BUFFER_BUDGET / (2 * static_cast<size_t>(num_partitions)), PAGE_SIZE, MAX_SPILL_BUFFER_BYTES);
+    return bytes / PAGE_SIZE * PAGE_SIZE / sizeof(TupleT);
+}
+
+// Path of partition p's spill file
+inline std::string spill_path(const std::string &dir, uint32_t p)
+{
+    return dir + "/part-" + std::to_string(p) + ".bin";
+}
+
+struct StreamingResult
+{
+    std::vector<uint64_t> sizes;    // tuples per partition
+    uint64_t tuples = 0;
+    uint64_t blocks = 0;
+    double seconds = 0.0;           // whole run, I/O included
+    double partition_seconds = 0.0; // inside Strategy::run, summed over blocks
+    double read_wait_seconds = 0.0; // waiting for the next block after partitioning and spilling one
+    uint64_t bytes_written = 0;     // spilled, O_DIRECT padding included
+    SpillIo io = SpillIo::Sync;     // spill backend actually used
+    bool direct = false;            // spill files opened with O_DIRECT
+    bool ok = false;
+
+    double throughput() const { return tuples / (seconds * 1e6); }           // MTuple/sec
+    double write_bandwidth() const { return bytes_written / (seconds * 1e6); } // MB/sec
+};
+
+/* Partition the tuple file `input_path` into spill files output_dir/part-<p>.bin.
+   The input is read in blocks with pread and double buffered: a reader thread fetches block
+   k + 1 while the workers of `pool` partition block k with Strategy (the existing scatter
+   kernels) and append its partitions to the spill files, worker t owning a range of
+   partitions. Full staging buffers are written asynchronously by the `spill` backend, so
+   spill writes overlap with partitioning the next block. A read_wait_seconds near zero means
+   reads kept up with partitioning; write_bandwidth() near the device's means writes bound the run.
+*/
+template <typename Strategy = CountThenMove, typename HashFn = MaskHash, typename TupleT = Tuple>
+StreamingResult stream_partition(const std::string &input_path, const std::string &output_dir, uint32_t bits,
+                                 WorkerPool &pool, const PartitionOptions &opts = {},
+                                 size_t block_tuples = STREAM_BLOCK_BYTES / sizeof(TupleT),
+                                 const SpillOptions &spill = {})
+{
+    auto begin = WorkerClock::now();
+    StreamingResult result;
+    const uint32_t num_partitions = 1u << bits;
+    const uint32_t threads = pool.size();
+
+    int fd = ::open(input_path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        std::cerr << "Cannot open " << input_path << ": " << std::strerror(errno) << "\n";
+        if (fd >= 0)
+            ::close(fd);
+        return result;
+    }
+    if (st.st_size % sizeof(TupleT) != 0)
+    {
+        std::cerr << input_path << " is not a whole number of " << sizeof(TupleT) << "-byte tuples\n";
+        ::close(fd);
+        return result;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    const uint64_t total = static_cast<uint64_t>(st.st_size) / sizeof(TupleT);
+
+    // Declared before the spill files, which wait for their writes when destroyed
+    AsyncWriter writer(spill);
+    result.io = writer.backend();
+    std::vector<SpillFile<TupleT>> spills(num_partitions);
+    AlignedArray<TupleT> blocks[2];
+    mkdir(output_dir.c_str(), 0755); // may already exist
+    try
+    {
+        const size_t buffer_tuples = spill_buffer_tuples<TupleT>(num_partitions);
+        for (uint32_t p = 0; p < num_partitions; ++p)
+        {
+            if (!spills[p].open(spill_path(output_dir, p), buffer_tuples, writer, spill.direct))
+            {
+                std::cerr << "Cannot create " << spill_path(output_dir, p) << ": " << std::strerror(errno) << "\n";
+                ::close(fd);
+                return result;
+            }
+        }
+        result.direct = spills[0].direct();
+        if (spill.direct && !result.direct)
+            std::cerr << "O_DIRECT not supported in " << output_dir << ", spilling through the page cache\n";
+        block_tuples = static_cast<size_t>(std::min<uint64_t>(block_tuples, std::max<uint64_t>(total, 1)));
+        for (auto &block : blocks)
+        {
+            block = AlignedArray<TupleT>(block_tuples, opts.pages);
+            block.prefault();
+        }
+    }
+    catch (const std::bad_alloc &e)
+    {
+        std::cerr << "Memory allocation failed for streaming buffers: " << e.what() << "\n";
+        ::close(fd);
+        return result;
+    }
+
+    // Fetch the block at tuple `first` into blocks[b]; returns its tuple count, or -1 on error
+    auto read_block = [&](int b, uint64_t first) -> int64_t
+    {
+        size_t want = static_cast<size_t>(std::min<uint64_t>(block_tuples, total - first));
+        ssize_t got = read_fully(fd, blocks[b].get(), want * sizeof(TupleT), first * sizeof(TupleT));
+        if (got != static_cast<ssize_t>(want * sizeof(TupleT)))
+        {
+            std::cerr << "Read of " << input_path << " failed at tuple " << first << ": " << std::strerror(errno) << "\n";
+            return -1;
+        }
+        return static_cast<int64_t>(want);
+    };
+
+    PartitionResult<typename Strategy::template Output<TupleT>> part;
+    const uint32_t partitions_per_thread = (num_partitions + threads - 1) / threads;
+    std::atomic<bool> spill_failed{false};
+    int64_t count = total > 0 ? read_block(0, 0) : 0;
+    bool ok = count >= 0;
+    for (uint64_t first = 0; ok && first < total;)
+    {
+        const int current = result.blocks % 2;
+        const uint64_t next_first = first + static_cast<uint64_t>(count);
+        int64_t next_count = 0;
+        std::thread reader;
+        if (next_first < total)
+            reader = std::thread([&]
+                                 { next_count = read_block(1 - current, next_first); });
+
+        if (!partition_into<Strategy, HashFn>(part, blocks[current].get(), static_cast<size_t>(count), bits, pool, opts))
+            ok = false;
+        result.partition_seconds += part.seconds;
+
+        // Append the block's partitions to the spill files, each worker its own partitions
+        if (ok)
+        {
+            pool.run([&](uint32_t t)
+                     {
+                uint32_t p_begin = std::min(num_partitions, t * partitions_per_thread);
+                uint32_t p_end = std::min(num_partitions, p_begin + partitions_per_thread);
+                for (uint32_t p = p_begin; p < p_end; ++p)
+                    part.output.for_each_run(p, [&](const TupleT *data, size_t n) {
+                        if (!spills[p].append(data, n) && !spill_failed.exchange(true))
+                            std::cerr << "Write of " << spill_path(output_dir, p) << " failed: " << std::strerror(errno) << "\n";
+                    }); });
+            ok = !spill_failed.load();
+        }
+
+        auto wait = WorkerClock::now();
+        if (reader.joinable())
+            reader.join();
+        result.read_wait_seconds += std::chrono::duration<double>(WorkerClock::now() - wait).count();
+        if (next_count < 0)
+            ok = false;
+        result.tuples += static_cast<uint64_t>(count);
+        result.blocks++;
+        first = next_first;
+        count = next_count;
+    }
+    ::close(fd);
+
+    for (uint32_t p = 0; ok && p < num_partitions; ++p)
+    {
+        if (!spills[p].finish())
+        {
+            std::cerr << "Write of " << spill_path(output_dir, p) << " failed: " << std::strerror(errno) << "\n";
+            ok = false;
+        }
+        result.sizes.push_back(spills[p].tuples());
+    }
+    spills.clear();
+    result.bytes_written = writer.bytes_written();
+    result.ok = ok;
+    result.seconds = std::chrono::duration<double>(WorkerClock::now() - begin).count();
+    return result;
+}
+
+/* Write a `count`-tuple input distributed as `spec` to `path`, generated block by block by the
+   workers of `pool`; identical to generate_input over the whole array, whatever its size.
+*/
+template <typename TupleT = Tuple>
+bool write_input_file(const std::string &path, uint64_t count, const InputSpec &spec, WorkerPool &pool,
+                      size_t block_tuples = STREAM_BLOCK_BYTES / sizeof(TupleT))
+{
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        std::cerr << "Cannot create " << path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    AlignedArray<TupleT> block(static_cast<size_t>(std::min<uint64_t>(block_tuples, std::max<uint64_t>(count, 1))));
+    const uint32_t threads = pool.size();
+    bool ok = true;
+    for (uint64_t first = 0; ok && first < count; first += block.size())
+    {
+        size_t n = static_cast<size_t>(std::min<uint64_t>(block.size(), count - first));
+        pool.run([&](uint32_t t)
+                 {
+            size_t offset, chunk;
+            static_chunk(n, threads, t, offset, chunk);
+            generate_range(block.get() + offset, first + offset, first + offset + chunk, count, spec); });
+        ok = write_fully(fd, block.get(), n * sizeof(TupleT), first * sizeof(TupleT));
+    }
+    if (!ok)
+        std::cerr << "Write of " << path << " failed: " << std::strerror(errno) << "\n";
+    ::close(fd);
+    return ok;
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "bench_report.h"
+#include "workers.h"
+
+/* Per-worker timeline of WorkerPool runs. Attached to a pool (pool.observe), it records for
+   every worker and run when each phase of the body started and ended; a phase ends at the
+   worker's arrival at a barrier, the next one starts when it leaves the barrier. The gaps are
+   time spent waiting for the other workers, which makes stragglers visible.
+   A run's spans are reserved before its start barrier, so recording them allocates nothing
+   inside the timed region.
+*/
+struct PhaseSpan
+{
+    WorkerClock::time_point start;
+    WorkerClock::time_point end;
+
+    double seconds() const { return std::chrono::duration<double>(end - start).count(); }
+};
+
+class WorkerTimeline : public RunObserver
+{
+public:
+    explicit WorkerTimeline(uint32_t threads) : threads_(threads)
+    {
+        for (uint32_t t = 0; t < threads; ++t)
+            threads_[t] = std::make_unique<ThreadTimeline>();
+    }
+
+    static constexpr size_t RESERVED_PHASES = 64; // spans reserved for a run, at least as many as the last one had
+
+    void prepare(uint32_t t) override
+    {
+        ThreadTimeline &w = *threads_[t];
+        const size_t phases = w.runs.empty() ? 0 : w.runs.back().size();
+        w.runs.emplace_back();
+        w.runs.back().reserve(std::max(RESERVED_PHASES, phases));
+    }
+
+    void begin(uint32_t t) override { threads_[t]->start = WorkerClock::now(); }
+
+    void phase(uint32_t t) override
+    {
+        ThreadTimeline &w = *threads_[t];
+        w.runs.back().push_back({w.start, WorkerClock::now()});
+    }
+
+    void resume(uint32_t t) override { threads_[t]->start = WorkerClock::now(); }
+
+    void end(uint32_t t) override { phase(t); }
+
+    uint32_t threads() const { return static_cast<uint32_t>(threads_.size()); }
+    uint32_t runs() const { return threads_.empty() ? 0 : static_cast<uint32_t>(threads_[0]->runs.size()); }
+
+    // Phases of worker t in run r
+    const std::vector<PhaseSpan> &spans(uint32_t t, uint32_t r) const { return threads_[t]->runs[r]; }
+
+    // Forget the observed runs
+    void clear()
+    {
+        for (auto &w : threads_)
+            w->runs.clear();
+    }
+
+private:
+    struct alignas(64) ThreadTimeline
+    {
+        WorkerClock::time_point start;
+        std::vector<std::vector<PhaseSpan>> runs;
+    };
+
+    std::vector<std::unique_ptr<ThreadTimeline>> threads_;
+};
+
+/* Load balance of the observed runs, times summed over the runs.
+   busy: time inside phases; waited: time at barriers, including the end barrier until the
+   last worker finished. An imbalance of 1 means every worker was busy equally long; the
+   straggler is the busiest worker. Phases are compared the same way, one by one.
+*/
+struct LoadBalance
+{
+    std::vector<double> busy_seconds;   // per worker
+    std::vector<double> waited_seconds; // per worker
+    double imbalance = 1.0;             // max / mean busy time
+    uint32_t straggler = 0;
+    std::vector<std::vector<double>> phase_seconds; // [phase][worker]
+    std::vector<double> phase_imbalance;
+    std::vector<uint32_t> phase_straggler;
+};
+
+// Max over mean, and the index of the max
+inline double max_over_mean(const std::vector<double> &values, uint32_t &argmax)
+{
+    auto max = std::max_element(values.begin(), values.end());
+    argmax = static_cast<uint32_t>(max - values.begin());
+    double sum = 0.0;
+    for (double v : values)
+        sum += v;
+    return sum > 0.0 ? *max * values.size() / sum : 1.0;
+}
+
+inline LoadBalance analyze_load(const WorkerTimeline &timeline)
+{
+    LoadBalance load;
+    const uint32_t threads = timeline.threads();
+    load.busy_seconds.assign(threads, 0.0);
+    load.waited_seconds.assign(threads, 0.0);
+    for (uint32_t r = 0; r < timeline.runs(); ++r)
+    {
+        WorkerClock::time_point first = WorkerClock::time_point::max(), last = WorkerClock::time_point::min();
+        for (uint32_t t = 0; t < threads; ++t)
+        {
+            const std::vector<PhaseSpan> &spans = timeline.spans(t, r);
+            if (spans.empty())
+                continue;
+            first = std::min(first, spans.front().start);
+            last = std::max(last, spans.back().end);
+        }
+        for (uint32_t t = 0; t < threads; ++t)
+        {
+            const std::vector<PhaseSpan> &spans = timeline.spans(t, r);
+            if (load.phase_seconds.size() < spans.size())
+                load.phase_seconds.resize(spans.size(), std::vector<double>(threads, 0.0));
+            double busy = 0.0;
+            for (size_t k = 0; k < spans.size(); ++k)
+            {
+                load.phase_seconds[k][t] += spans[k].seconds();
+                busy += spans[k].seconds();
+            }
+            load.busy_seconds[t] += busy;
+            load.waited_seconds[t] += std::chrono::duration<double>(last - first).count() - busy;
+        }
+    }
+    if (threads == 0)
+        return load;
+    load.imbalance = max_over_mean(load.busy_seconds, load.straggler);
+    for (const std::vector<double> &phase : load.phase_seconds)
+    {
+        uint32_t straggler;
+        load.phase_imbalance.push_back(max_over_mean(phase, straggler));
+        load.phase_straggler.push_back(straggler);
+    }
+    return load;
+}
+
+/* Timelines in the Chrome trace event format (chrome://tracing, Perfetto): one process per
+   benchmark case, one thread per worker, one complete event per phase and run, on a common
+   microsecond clock starting at the first recorded event.
+*/
+class ChromeTrace
+{
+public:
+    void add(const std::string &name, const WorkerTimeline &timeline)
+    {
+        const uint32_t pid = processes_++;
+        events_.push_back({"process_name", pid, 0, 'M', {}, {}, name});
+        for (uint32_t t = 0; t < timeline.threads(); ++t)
+        {
+            events_.push_back({"thread_name", pid, t, 'M', {}, {}, "worker " + std::to_string(t)});
+            for (uint32_t r = 0; r < timeline.runs(); ++r)
+            {
+                const std::vector<PhaseSpan> &spans = timeline.spans(t, r);
+                for (size_t k = 0; k < spans.size(); ++k)
+                {
+                    events_.push_back({"phase " + std::to_string(k), pid, t, 'X', spans[k].start, spans[k].end,
+                                       "run " + std::to_string(r)});
+                    origin_ = std::min(origin_, spans[k].start);
+                }
+            }
+        }
+    }
+
+    void write(std::ostream &out) const
+    {
+        auto micros = [this](WorkerClock::time_point time)
+        { return std::chrono::duration<double, std::micro>(time - origin_).count(); };
+        out << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+        for (size_t i = 0; i < events_.size(); ++i)
+        {
+            const Event &e = events_[i];
+            out << (i ? ",\n" : "") << "{\"name\": " << json_string(e.name) << ", \"ph\": \"" << e.phase
+                << "\", \"pid\": " << e.pid << ", \"tid\": " << e.tid;
+            if (e.phase == 'M')
+                out << ", \"args\": {\"name\": " << json_string(e.label) << "}}";
+            else
+                out << ", \"ts\": " << micros(e.start) << ", \"dur\": " << micros(e.end) - micros(e.start)
+                    << ", \"args\": {\"run\": " << json_string(e.label) << "}}";
+        }
+        out << "\n]}\n";
+    }
+
+private:
+    struct Event
+    {
+        std::string name;
+        uint32_t pid;
+        uint32_t tid;
+        char phase; // 'M' metadata, 'X' complete event
+        WorkerClock::time_point start;
+        WorkerClock::time_point end;
+        std::string label;
+    };
+
+    std::vector<Event> events_;
+    uint32_t processes_ = 0;
+    WorkerClock::time_point origin_ = WorkerClock::time_point::max();
+};
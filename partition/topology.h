@@ -0,0 +1,331 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "numa.h"
+
+/* CPU topology read from /sys/devices/system/cpu and /sys/devices/system/node, and the
+   pinning policies built on it. Every policy returns PUs in the order workers take them
+   (worker t runs on cores[t % cores.size()]):
+   - compact:              fill one node at a time, its physical cores first, then their SMT siblings
+   - scatter:              round-robin over nodes, each node in compact order
+   - physical-cores-first: one PU of every core of every node, then the second SMT thread of each
+   - smt-pairs:            both SMT threads of a core before the next core, node by node
+   - node<N> (per-node):   only the PUs of node N, in compact order
+*/
+
+// One processing unit (hardware thread)
+struct ProcessingUnit
+{
+    int id = 0;
+    int package = 0;
+    int core = 0;       // index into Topology::cores
+    int node = 0;
+    int smt_index = 0;  // position among the SMT siblings of its core
+    int l2_group = -1;  // lowest PU sharing its L2 (-1: unknown)
+    int l3_group = -1;  // lowest PU sharing its L3 (-1: unknown)
+};
+
+// One physical core and its SMT siblings, ordered by smt_index
+struct PhysicalCore
+{
+    int package = 0;
+    int node = 0;
+    std::vector<int> pus;
+};
+
+struct Topology
+{
+    std::vector<ProcessingUnit> pus; // ordered by id
+    std::vector<PhysicalCore> cores; // ordered by node, package, first PU
+    int packages = 0;
+    int nodes = 0;
+    int l2_groups = 0;
+    int l3_groups = 0;
+};
+
+// Parse a sysfs CPU list such as "0-3,8,10-11"
+inline std::vector<int> parse_cpu_list(const std::string &list)
+{
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ','))
+    {
+        if (range.empty())
+            continue;
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// First token of a sysfs file, or `fallback` if it cannot be read
+inline std::string read_sysfs(const std::string &path, const std::string &fallback = "")
+{
+    std::ifstream file(path);
+    std::string value;
+    return (file >> value) ? value : fallback;
+}
+
+// Lowest PU sharing the cache of the given level with `cpu`, or -1
+inline int cache_group(int cpu, int level)
+{
+    std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cache/index";
+    for (int index = 0;; ++index)
+    {
+        std::string level_text = read_sysfs(dir + std::to_string(index) + "/level");
+        if (level_text.empty())
+            return -1;
+        if (std::stoi(level_text) != level)
+            continue;
+        std::vector<int> shared = parse_cpu_list(read_sysfs(dir + std::to_string(index) + "/shared_cpu_list"));
+        return shared.empty() ? -1 : *std::min_element(shared.begin(), shared.end());
+    }
+}
+
+/* Discover the online PUs. Missing files degrade gracefully: a PU without topology
+   information is its own core on package 0.
+*/
+inline Topology discover_topology()
+{
+    Topology topo;
+    std::string online = read_sysfs("/sys/devices/system/cpu/online");
+    std::vector<int> ids = parse_cpu_list(online);
+    if (ids.empty())
+        ids.push_back(0);
+
+    std::map<std::tuple<int, int, int>, int> core_index; // (node, package, core_id) -> cores[]
+    for (int id : ids)
+    {
+        std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(id) + "/topology/";
+        ProcessingUnit pu;
+        pu.id = id;
+        pu.package = std::stoi(read_sysfs(dir + "physical_package_id", "0"));
+        pu.node = numa_node_of_cpu(id);
+        pu.l2_group = cache_group(id, 2);
+        pu.l3_group = cache_group(id, 3);
+        int core_id = std::stoi(read_sysfs(dir + "core_id", std::to_string(id)));
+
+        std::vector<int> siblings = parse_cpu_list(read_sysfs(dir + "thread_siblings_list", std::to_string(id)));
+        pu.smt_index = static_cast<int>(std::find(siblings.begin(), siblings.end(), id) - siblings.begin());
+        topo.pus.push_back(pu);
+
+        auto key = std::make_tuple(pu.node, pu.package, core_id);
+        if (!core_index.count(key))
+        {
+            core_index[key] = static_cast<int>(core_index.size());
+            topo.cores.push_back({pu.package, pu.node, {}});
+        }
+        topo.pus.back().core = core_index[key];
+        topo.cores[core_index[key]].pus.push_back(id);
+    }
+
+    // Order cores by node, package and first PU, and renumber the PUs' core index
+    std::vector<int> order(topo.cores.size());
+    for (size_t c = 0; c < order.size(); ++c)
+        order[c] = static_cast<int>(c);
+    std::sort(order.begin(), order.end(), [&](int a, int b)
+              { return std::make_tuple(topo.cores[a].node, topo.cores[a].package, topo.cores[a].pus[0]) <
+                       std::make_tuple(topo.cores[b].node, topo.cores[b].package, topo.cores[b].pus[0]); });
+    std::vector<PhysicalCore> sorted;
+    std::vector<int> renumber(order.size());
+    for (size_t c = 0; c < order.size(); ++c)
+    {
+        renumber[order[c]] = static_cast<int>(c);
+        sorted.push_back(topo.cores[order[c]]);
+    }
+    topo.cores = std::move(sorted);
+
+    std::vector<int> packages, nodes, l2, l3;
+    for (ProcessingUnit &pu : topo.pus)
+    {
+        pu.core = renumber[pu.core];
+        PhysicalCore &core = topo.cores[pu.core];
+        std::sort(core.pus.begin(), core.pus.end());
+        packages.push_back(pu.package);
+        nodes.push_back(pu.node);
+        l2.push_back(pu.l2_group);
+        l3.push_back(pu.l3_group);
+    }
+    auto distinct = [](std::vector<int> &v)
+    {
+        std::sort(v.begin(), v.end());
+        return static_cast<int>(std::unique(v.begin(), v.end()) - v.begin());
+    };
+    topo.packages = distinct(packages);
+    topo.nodes = distinct(nodes);
+    topo.l2_groups = distinct(l2);
+    topo.l3_groups = distinct(l3);
+    return topo;
+}
+
+// Topology of this machine, discovered once
+inline const Topology &topology()
+{
+    static const Topology topo = discover_topology();
+    return topo;
+}
+
+// "2 packages, 2 nodes, 16 cores, 32 PUs, 16 L2 / 2 L3 groups"
+inline std::string describe_topology(const Topology &topo)
+{
+    return std::to_string(topo.packages) + " packages, " + std::to_string(topo.nodes) + " nodes, " +
+           std::to_string(topo.cores.size()) + " cores, " + std::to_string(topo.pus.size()) + " PUs, " +
+           std::to_string(topo.l2_groups) + " L2 / " + std::to_string(topo.l3_groups) + " L3 groups";
+}
+
+enum class PinningPolicy
+{
+    None,
+    Compact,
+    Scatter,
+    PhysicalCoresFirst,
+    SmtPairs,
+    PerNode
+};
+
+inline const char *pinning_policy_name(PinningPolicy policy)
+{
+    switch (policy)
+    {
+    case PinningPolicy::Compact:
+        return "compact";
+    case PinningPolicy::Scatter:
+        return "scatter";
+    case PinningPolicy::PhysicalCoresFirst:
+        return "physical-cores-first";
+    case PinningPolicy::SmtPairs:
+        return "smt-pairs";
+    case PinningPolicy::PerNode:
+        return "node";
+    default:
+        return "none";
+    }
+}
+
+// "none", "compact", "scatter", "physical-cores-first", "smt-pairs" or "node<N>"; returns false for anything else
+inline bool parse_pinning_policy(const std::string &s, PinningPolicy &policy, int &node)
+{
+    if (s == "none")
+        policy = PinningPolicy::None;
+    else if (s == "compact")
+        policy = PinningPolicy::Compact;
+    else if (s == "scatter")
+        policy = PinningPolicy::Scatter;
+    else if (s == "physical-cores-first")
+        policy = PinningPolicy::PhysicalCoresFirst;
+    else if (s == "smt-pairs")
+        policy = PinningPolicy::SmtPairs;
+    else
+    {
+        NumaPolicy unused;
+        if (!parse_numa_policy(s, unused, node) || unused != NumaPolicy::Node)
+            return false;
+        policy = PinningPolicy::PerNode;
+    }
+    return true;
+}
+
+// PUs of one node: its physical cores first, then their SMT siblings
+inline std::vector<int> node_pus_compact(const Topology &topo, int node)
+{
+    std::vector<int> pus;
+    for (size_t smt = 0;; ++smt)
+    {
+        size_t before = pus.size();
+        bool any_core = false;
+        for (const PhysicalCore &core : topo.cores)
+        {
+            if (core.node != node)
+                continue;
+            any_core = true;
+            if (smt < core.pus.size())
+                pus.push_back(core.pus[smt]);
+        }
+        if (!any_core || pus.size() == before)
+            return pus;
+    }
+}
+
+/* All PUs in the order of `policy` (node: for PinningPolicy::PerNode). Empty for None.
+   Callers pin worker t to cores[t % cores.size()], so more threads than PUs wrap around.
+*/
+inline std::vector<int> pinning_order(const Topology &topo, PinningPolicy policy, int node = 0)
+{
+    std::vector<int> nodes;
+    for (const PhysicalCore &core : topo.cores)
+    {
+        if (nodes.empty() || nodes.back() != core.node)
+            nodes.push_back(core.node);
+    }
+
+    std::vector<int> pus;
+    switch (policy)
+    {
+    case PinningPolicy::Compact:
+        for (int n : nodes)
+        {
+            std::vector<int> node_pus = node_pus_compact(topo, n);
+            pus.insert(pus.end(), node_pus.begin(), node_pus.end());
+        }
+        break;
+    case PinningPolicy::Scatter:
+    {
+        std::vector<std::vector<int>> per_node;
+        for (int n : nodes)
+            per_node.push_back(node_pus_compact(topo, n));
+        for (size_t i = 0; pus.size() < topo.pus.size(); ++i)
+        {
+            for (const std::vector<int> &node_pus : per_node)
+            {
+                if (i < node_pus.size())
+                    pus.push_back(node_pus[i]);
+            }
+        }
+        break;
+    }
+    case PinningPolicy::PhysicalCoresFirst:
+        for (size_t smt = 0; pus.size() < topo.pus.size(); ++smt)
+        {
+            for (const PhysicalCore &core : topo.cores)
+            {
+                if (smt < core.pus.size())
+                    pus.push_back(core.pus[smt]);
+            }
+        }
+        break;
+    case PinningPolicy::SmtPairs:
+        for (const PhysicalCore &core : topo.cores)
+            pus.insert(pus.end(), core.pus.begin(), core.pus.end());
+        break;
+    case PinningPolicy::PerNode:
+        pus = node_pus_compact(topo, node);
+        break;
+    default:
+        break;
+    }
+    return pus;
+}
+
+// The PUs the first `threads` workers are pinned to (wrapping around when there are fewer PUs)
+inline std::vector<int> pin_cores(PinningPolicy policy, uint32_t threads, int node = 0)
+{
+    std::vector<int> order = pinning_order(topology(), policy, node);
+    if (order.empty())
+        return order;
+    std::vector<int> cores;
+    for (uint32_t t = 0; t < threads; ++t)
+        cores.push_back(order[t % order.size()]);
+    return cores;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Tuple layout from the paper: 8B key + 8B payload
+struct Tuple
+{
+    uint64_t key;
+    uint64_t payload;
+};
+
+constexpr size_t TUPLE_SIZE = sizeof(Tuple); // 16 bytes
+static_assert(TUPLE_SIZE == 16, "paper tuples are 16 bytes");
+
+/* Rows of other widths: the 8B key first, then (Bytes - 8) / 8 payload words.
+   The kernels take any of them as TupleT; 8B rows are bare keys.
+*/
+template <size_t Bytes>
+struct WideTuple
+{
+    static_assert(Bytes % 8 == 0 && Bytes > 8 && Bytes <= 64, "8B words, at most one cache line");
+    uint64_t key;
+    uint64_t payload[Bytes / 8 - 1];
+};
+
+template <>
+struct WideTuple<8>
+{
+    uint64_t key;
+};
+
+// The row type of `Bytes` bytes; 16B rows are the paper's Tuple
+template <size_t Bytes>
+using TupleOf = std::conditional_t<Bytes == TUPLE_SIZE, Tuple, WideTuple<Bytes>>;
+
+// Store `value` in every payload word of t (nothing for bare keys)
+template <typename TupleT>
+inline void set_payload(TupleT &t, uint64_t value)
+{
+    if constexpr (requires { t.payload[0]; })
+    {
+        for (uint64_t &word : t.payload)
+            word = value;
+    }
+    else if constexpr (requires { t.payload; })
+        t.payload = value;
+}
+
+// The first payload word of t (the key of bare keys)
+template <typename TupleT>
+inline uint64_t payload_word(const TupleT &t)
+{
+    if constexpr (requires { t.payload[0]; })
+        return t.payload[0];
+    else if constexpr (requires { t.payload; })
+        return t.payload;
+    else
+        return t.key;
+}
+
+// Call f(std::type_identity<TupleOf<bytes>>{}) for 8, 16, 32 or 64 bytes; false for any other width
+template <typename F>
+bool visit_tuple_width(size_t bytes, F &&f)
+{
+    switch (bytes)
+    {
+    case 8:
+        f(std::type_identity<TupleOf<8>>{});
+        return true;
+    case 16:
+        f(std::type_identity<TupleOf<16>>{});
+        return true;
+    case 32:
+        f(std::type_identity<TupleOf<32>>{});
+        return true;
+    case 64:
+        f(std::type_identity<TupleOf<64>>{});
+        return true;
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,488 @@
+#pragma once
+
+#include <immintrin.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "affinity.h"
+
+/* Per-worker instrumentation of WorkerPool runs: prepare(t) before the start barrier, outside
+   the timed region (for allocations and syscalls), begin(t) right after it, phase(t) whenever
+   worker t arrives at a barrier inside the body (the end of one of the body's phases) and
+   resume(t) when it leaves it, end(t) right before the end barrier.
+   Called on worker t's own thread.
+*/
+class RunObserver
+{
+public:
+    virtual ~RunObserver() = default;
+    virtual void prepare(uint32_t) {}
+    virtual void begin(uint32_t t) = 0;
+    virtual void phase(uint32_t t) = 0;
+    virtual void resume(uint32_t) {}
+    virtual void end(uint32_t t) = 0;
+
+    // Seconds the observer itself added to the timed region of the last run, to subtract from it
+    virtual double overhead_seconds() const { return 0.0; }
+};
+
+// Several observers of the same runs, notified in order
+class RunObservers : public RunObserver
+{
+public:
+    explicit RunObservers(std::vector<RunObserver *> observers) : observers_(std::move(observers)) {}
+
+    void prepare(uint32_t t) override
+    {
+        for (RunObserver *o : observers_)
+            o->prepare(t);
+    }
+
+    void begin(uint32_t t) override
+    {
+        for (RunObserver *o : observers_)
+            o->begin(t);
+    }
+    void phase(uint32_t t) override
+    {
+        for (RunObserver *o : observers_)
+            o->phase(t);
+    }
+    void resume(uint32_t t) override
+    {
+        for (RunObserver *o : observers_)
+            o->resume(t);
+    }
+    void end(uint32_t t) override
+    {
+        for (RunObserver *o : observers_)
+            o->end(t);
+    }
+    double overhead_seconds() const override
+    {
+        double seconds = 0.0;
+        for (const RunObserver *o : observers_)
+            seconds += o->overhead_seconds();
+        return seconds;
+    }
+
+private:
+    std::vector<RunObserver *> observers_;
+};
+
+// Observer of the run the calling worker is executing, if any
+struct ObservedWorker
+{
+    RunObserver *observer = nullptr;
+    uint32_t thread = 0;
+};
+inline thread_local ObservedWorker observed_worker;
+
+/* Sense-reversing barrier for a fixed number of threads. The last thread to arrive resets
+   the count and flips the sense; the others spin until it flips. A thread cannot get a full
+   episode ahead, since the next flip needs every thread to arrive again.
+   Spinning yields after a while, so oversubscribed PUs still make progress.
+*/
+class SenseBarrier
+{
+public:
+    explicit SenseBarrier(uint32_t count) : count_(count), remaining_(count) {}
+
+    void arrive_and_wait()
+    {
+        RunObserver *observer = observed_worker.observer;
+        if (observer)
+            observer->phase(observed_worker.thread);
+        wait([] {});
+        if (observer)
+            observer->resume(observed_worker.thread);
+    }
+
+    // Wait without notifying observers; the last thread to arrive calls completion() before releasing the others
+    template <typename F>
+    void wait(F &&completion)
+    {
+        bool sense = sense_.load(std::memory_order_relaxed);
+        if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            completion();
+            remaining_.store(count_, std::memory_order_relaxed);
+            sense_.store(!sense, std::memory_order_release);
+            return;
+        }
+        for (uint32_t spins = 0; sense_.load(std::memory_order_acquire) == sense; ++spins)
+        {
+            if (spins < SPINS_BEFORE_YIELD)
+                _mm_pause();
+            else
+                std::this_thread::yield();
+        }
+    }
+
+private:
+    static constexpr uint32_t SPINS_BEFORE_YIELD = 1024;
+
+    const uint32_t count_;
+    alignas(64) std::atomic<uint32_t> remaining_;
+    alignas(64) std::atomic<bool> sense_{false};
+};
+
+using WorkerClock = std::chrono::steady_clock;
+
+// Timestamps of one WorkerPool::run
+struct WorkerRun
+{
+    WorkerClock::time_point dispatched; // run() called
+    WorkerClock::time_point started;    // all workers passed the start barrier
+    WorkerClock::time_point finished;   // all workers reached the end barrier
+    WorkerClock::time_point returned;   // run() about to return
+
+    double seconds() const { return std::chrono::duration<double>(finished - started).count(); }
+};
+
+/* Fixed set of pinned threads reused across runs. Thread creation, pinning and wake-up
+   happen outside the timed region: workers meet at a start barrier, the clock runs from its
+   release to the end barrier, and idle workers sleep on a condition variable.
+   Worker t runs on cores[t % cores.size()]; empty cores: not pinned.
+*/
+class WorkerPool
+{
+public:
+    WorkerPool(uint32_t threads, const std::vector<int> &cores = {}) : barrier_(threads), threads_(threads)
+    {
+        workers_.reserve(threads);
+        for (uint32_t t = 0; t < threads; ++t)
+        {
+            workers_.emplace_back([this, t, cores]()
+                                  {
+                if (!cores.empty())
+                    pin_current_thread(cores[t % cores.size()]);
+                work(t); });
+        }
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto &w : workers_)
+            w.join();
+    }
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    uint32_t size() const { return threads_; }
+
+    // Barrier over all workers, for phases inside a body
+    SenseBarrier &barrier() { return barrier_; }
+
+    /* Run body(t) on every worker t and wait for all of them.
+       Returns the seconds between the start and the end barrier; see last_run() for the rest.
+    */
+    double run(const std::function<void(uint32_t)> &body)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        last_.dispatched = WorkerClock::now();
+        body_ = &body;
+        pending_ = threads_;
+        ++generation_;
+        wake_.notify_all();
+        done_.wait(lock, [this]
+                   { return pending_ == 0; });
+        body_ = nullptr;
+        last_.returned = WorkerClock::now();
+        return last_.seconds();
+    }
+
+    const WorkerRun &last_run() const { return last_; }
+
+    // Observe the following runs (nullptr: stop observing); only between runs
+    void observe(RunObserver *observer)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        observer_ = observer;
+    }
+
+private:
+    void work(uint32_t t)
+    {
+        uint64_t seen = 0;
+        for (;;)
+        {
+            const std::function<void(uint32_t)> *body;
+            RunObserver *observer;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&]
+                           { return stop_ || generation_ != seen; });
+                if (stop_)
+                    return;
+                seen = generation_;
+                body = body_;
+                observer = observer_;
+            }
+
+            if (observer)
+                observer->prepare(t);
+            // Stamped by the last worker to arrive: a worker descheduled right after the barrier
+            // must not start the clock late while the others already steal its morsels
+            barrier_.wait([this]
+                          { last_.started = WorkerClock::now(); });
+            if (observer)
+            {
+                observer->begin(t);
+                observed_worker = {observer, t};
+            }
+            (*body)(t);
+            if (observer)
+            {
+                observed_worker = {};
+                observer->end(t);
+            }
+            barrier_.wait([this]
+                          { last_.finished = WorkerClock::now(); });
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--pending_ == 0)
+                done_.notify_one();
+        }
+    }
+
+    SenseBarrier barrier_;
+    const uint32_t threads_;
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(uint32_t)> *body_ = nullptr;
+    RunObserver *observer_ = nullptr;
+    uint64_t generation_ = 0;
+    uint32_t pending_ = 0;
+    bool stop_ = false;
+    WorkerRun last_;
+};
+
+// Input range [offset, offset + count) of worker t when n tuples are split statically
+inline void static_chunk(size_t n, uint32_t threads, uint32_t t, size_t &offset, size_t &count)
+{
+    size_t chunk_size = n / threads;
+    offset = t * chunk_size;
+    count = (t == threads - 1) ? n - offset : chunk_size;
+}
+
+/* Work-stealing deques over item ids [0, n): worker t owns the contiguous range
+   [t * n / threads, (t + 1) * n / threads), or [first[t], first[t + 1]) when the ranges are
+   given, pops from its front and, once it is empty, steals from the back of the other ranges. Workers on the same NUMA node as t (`nodes`, one per
+   worker; empty: all alike) are robbed first, so stolen items are local when they can be.
+   Front and back share one 64-bit word per range, so owner and thieves claim by CAS and
+   every id goes to exactly one worker.
+*/
+class StealingQueue
+{
+public:
+    void reset(uint32_t n, uint32_t threads, const std::vector<int> &nodes = {})
+    {
+        std::vector<uint32_t> first(threads + 1);
+        for (uint32_t t = 0; t <= threads; ++t)
+            first[t] = static_cast<uint32_t>(uint64_t(n) * t / threads);
+        reset(first, nodes);
+    }
+
+    // Worker t owns [first[t], first[t + 1]); first has threads + 1 ascending entries
+    void reset(const std::vector<uint32_t> &first, const std::vector<int> &nodes = {})
+    {
+        const uint32_t threads = static_cast<uint32_t>(first.size() - 1);
+        if (threads_ != threads)
+            ranges_ = std::make_unique<Range[]>(threads);
+        threads_ = threads;
+        for (uint32_t t = 0; t < threads; ++t)
+            ranges_[t].bounds.store(first[t] | uint64_t(first[t + 1]) << 32, std::memory_order_relaxed);
+        if (nodes_ != nodes || victims_.size() != threads)
+        {
+            nodes_ = nodes;
+            victims_.assign(threads, {});
+            auto node = [&](uint32_t t)
+            { return nodes.empty() ? 0 : nodes[t % nodes.size()]; };
+            for (uint32_t t = 0; t < threads; ++t)
+            {
+                for (int local = 1; local >= 0; --local)
+                    for (uint32_t i = 1; i < threads; ++i)
+                        if ((node((t + i) % threads) == node(t)) == static_cast<bool>(local))
+                            victims_[t].push_back((t + i) % threads);
+            }
+        }
+    }
+
+    // Next item of worker t's own range, or false once it is empty
+    bool pop_own(uint32_t t, uint32_t &item) { return claim(ranges_[t], false, item); }
+
+    // An item from the back of another worker's range, nearest first; false once all are empty
+    bool steal(uint32_t t, uint32_t &item)
+    {
+        for (uint32_t v : victims_[t])
+        {
+            if (claim(ranges_[v], true, item))
+                return true;
+        }
+        return false;
+    }
+
+    bool pop(uint32_t t, uint32_t &item) { return pop_own(t, item) || steal(t, item); }
+
+private:
+    struct Range
+    {
+        alignas(64) std::atomic<uint64_t> bounds{0}; // front in the low half, back (exclusive) in the high half
+    };
+
+    static bool claim(Range &range, bool from_back, uint32_t &item)
+    {
+        uint64_t bounds = range.bounds.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            uint32_t front = static_cast<uint32_t>(bounds), back = static_cast<uint32_t>(bounds >> 32);
+            if (front >= back)
+                return false;
+            uint64_t next = from_back ? front | uint64_t(back - 1) << 32 : (front + 1) | uint64_t(back) << 32;
+            if (range.bounds.compare_exchange_weak(bounds, next, std::memory_order_relaxed))
+            {
+                item = from_back ? back - 1 : front;
+                return true;
+            }
+        }
+    }
+
+    std::unique_ptr<Range[]> ranges_;
+    std::vector<std::vector<uint32_t>> victims_;
+    std::vector<int> nodes_;
+    uint32_t threads_ = 0;
+};
+
+/* The input of a run handed out in morsels of `morsel_tuples` through a StealingQueue:
+   worker t first takes the morsels its static_chunk splits into (the chunk NUMA placement put
+   on its node and skew sampling sized its buffers for), front to back, then steals. A slow or
+   preempted worker leaves its remaining morsels to the others instead of stalling the run.
+   morsel_tuples == 0 gives every worker exactly its static chunk, without stealing.
+   `budget` caps the tuples a worker takes, as a multiple of its static chunk (0: no cap), for
+   outputs with per-worker capacities. The cap is never below the chunk itself, so a worker's
+   own morsels always fit and it only steals while a whole morsel still does: with a budget
+   of 1, workers steal nothing and keep exactly their chunks.
+   Every worker's morsels are logged, so a second pass can replay exactly the same tuples.
+*/
+class MorselSchedule
+{
+public:
+    void reset(size_t n, uint32_t threads, size_t morsel_tuples, const std::vector<int> &nodes = {}, double budget = 0.0)
+    {
+        n_ = n;
+        threads_ = threads;
+        morsel_tuples_ = morsel_tuples;
+        first_.resize(threads + 1);
+        first_[0] = 0;
+        if (workers_.size() < threads)
+            workers_.resize(threads);
+        for (uint32_t t = 0; t < threads; ++t)
+        {
+            size_t offset, count;
+            static_chunk(n, threads, t, offset, count);
+            const size_t morsels = morsel_tuples ? (count + morsel_tuples - 1) / morsel_tuples : 1;
+            first_[t + 1] = first_[t] + static_cast<uint32_t>(morsels);
+            workers_[t].log.clear();
+            workers_[t].log.reserve(morsels);
+            workers_[t].tuples = 0;
+            workers_[t].budget = budget > 0.0 ? std::max(count, static_cast<size_t>(budget * count)) : SIZE_MAX;
+        }
+        queue_.reset(first_, nodes);
+    }
+
+    // Call f(offset, count) for every morsel worker t gets, own ones first
+    template <typename F>
+    void run(uint32_t t, F &&f)
+    {
+        Worker &w = workers_[t];
+        uint32_t m;
+        while (queue_.pop_own(t, m))
+            take(w, m, f);
+        if (morsel_tuples_ == 0)
+            return;
+        while (w.tuples + morsel_tuples_ <= w.budget && queue_.steal(t, m))
+            take(w, m, f);
+    }
+
+    // Call f(offset, count) again for the morsels worker t got in run(), in the same order
+    template <typename F>
+    void replay(uint32_t t, F &&f) const
+    {
+        for (uint32_t m : workers_[t].log)
+        {
+            size_t offset, count;
+            bounds(m, offset, count);
+            f(offset, count);
+        }
+    }
+
+    // Tuples each worker took in the last run
+    std::vector<size_t> worker_tuples() const
+    {
+        std::vector<size_t> tuples(threads_);
+        for (uint32_t t = 0; t < threads_; ++t)
+            tuples[t] = workers_[t].tuples;
+        return tuples;
+    }
+
+private:
+    struct alignas(64) Worker
+    {
+        std::vector<uint32_t> log;
+        size_t tuples = 0;
+        size_t budget = SIZE_MAX;
+    };
+
+    template <typename F>
+    void take(Worker &w, uint32_t m, F &f)
+    {
+        size_t offset, count;
+        bounds(m, offset, count);
+        w.log.push_back(m);
+        w.tuples += count;
+        f(offset, count);
+    }
+
+    // Morsel m is the (m - first_[t])-th of the static chunk of its owner t
+    void bounds(uint32_t m, size_t &offset, size_t &count) const
+    {
+        const uint32_t t = static_cast<uint32_t>(std::upper_bound(first_.begin(), first_.end(), m) - first_.begin()) - 1;
+        size_t chunk_offset, chunk_count;
+        static_chunk(n_, threads_, t, chunk_offset, chunk_count);
+        if (morsel_tuples_ == 0)
+        {
+            offset = chunk_offset;
+            count = chunk_count;
+            return;
+        }
+        offset = chunk_offset + (m - first_[t]) * morsel_tuples_;
+        count = std::min(morsel_tuples_, chunk_offset + chunk_count - offset);
+    }
+
+    StealingQueue queue_;
+    std::vector<Worker> workers_;
+    std::vector<uint32_t> first_; // [thread] first morsel of its static chunk, then the total
+    size_t n_ = 0;
+    size_t morsel_tuples_ = 0;
+    uint32_t threads_ = 0;
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <immintrin.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "cpu_features.h"
+
+/* Software write-combining (SWWC) for the scatter loops.
+   Instead of writing every tuple straight into its partition buffer, a thread stages
+   tuples in one cache line per partition and only touches the partition buffer once a
+   full 64B line has accumulated. The full line is written with non-temporal stores, so
+   the destination never has to be read into the cache (no read-for-ownership) and the
+   scattered output does not evict the staging lines.
+*/
+
+constexpr uint32_t WC_LINE_SIZE = 64; // Bytes per staged line (one cache line)
+
+// Copies one 64B line from `src` to the 64B-aligned `dst` with streaming stores
+using StreamLineFn = void (*)(void *dst, const void *src);
+
+struct StreamKernel
+{
+    const char *name;
+    StreamLineFn stream_line;
+};
+
+// x86-64 baseline: 8 x MOVNTI, no vector extension needed
+inline void stream_line_scalar(void *dst, const void *src)
+{
+    long long *d = static_cast<long long *>(dst);
+    const long long *s = static_cast<const long long *>(src);
+    for (int i = 0; i < 8; ++i)
+        _mm_stream_si64(d + i, s[i]);
+}
+
+__attribute__((target("avx2"))) inline void stream_line_avx2(void *dst, const void *src)
+{
+    __m256i *d = static_cast<__m256i *>(dst);
+    const __m256i *s = static_cast<const __m256i *>(src);
+    _mm256_stream_si256(d, _mm256_load_si256(s));
+    _mm256_stream_si256(d + 1, _mm256_load_si256(s + 1));
+}
+
+__attribute__((target("avx512f"))) inline void stream_line_avx512(void *dst, const void *src)
+{
+    _mm512_stream_si512(static_cast<__m512i *>(dst), _mm512_load_si512(src));
+}
+
+// Pick the widest streaming store the CPU supports
+inline StreamKernel detect_stream_kernel()
+{
+    const CpuFeatures &features = cpu_features();
+    if (features.avx512f)
+        return {"avx512", stream_line_avx512};
+    if (features.avx2)
+        return {"avx2", stream_line_avx2};
+    return {"scalar", stream_line_scalar};
+}
+
+/* Per-thread staging area: one cache-line-aligned line of TUPLES_PER_LINE tuples per partition.
+   Destinations handed to flush_line() must be 64B aligned, i.e. partition buffers allocated
+   with 64B alignment and written in whole lines until the final flush_partial().
+*/
+template <typename TupleT>
+struct WriteCombiner
+{
+    static constexpr uint32_t TUPLES_PER_LINE = WC_LINE_SIZE / sizeof(TupleT);
+    static_assert(WC_LINE_SIZE % sizeof(TupleT) == 0, "tuples must tile a cache line");
+
+    TupleT *lines;
+    uint8_t *fill;
+    uint32_t num_partitions;
+    StreamLineFn stream_line;
+
+    WriteCombiner(uint32_t partitions, StreamLineFn stream)
+        : num_partitions(partitions), stream_line(stream)
+    {
+        lines = static_cast<TupleT *>(aligned_alloc(WC_LINE_SIZE, static_cast<size_t>(partitions) * WC_LINE_SIZE));
+        fill = static_cast<uint8_t *>(calloc(partitions, sizeof(uint8_t)));
+        if (!lines || !fill)
+            throw std::bad_alloc();
+    }
+
+    ~WriteCombiner()
+    {
+        free(lines);
+        free(fill);
+    }
+
+    WriteCombiner(const WriteCombiner &) = delete;
+    WriteCombiner &operator=(const WriteCombiner &) = delete;
+
+    // Stage a tuple; returns true once the line of partition p is full and must be flushed
+    inline bool stage(uint32_t p, const TupleT &t)
+    {
+        lines[static_cast<size_t>(p) * TUPLES_PER_LINE + fill[p]] = t;
+        return ++fill[p] == TUPLES_PER_LINE;
+    }
+
+    // Stream the full line of partition p to the 64B-aligned dst and empty it
+    inline void flush_line(uint32_t p, TupleT *dst)
+    {
+        stream_line(dst, lines + static_cast<size_t>(p) * TUPLES_PER_LINE);
+        fill[p] = 0;
+    }
+
+    uint32_t pending(uint32_t p) const { return fill[p]; }
+
+    // Copy the remaining tuples of partition p with regular stores (dst needs no alignment)
+    void flush_partial(uint32_t p, TupleT *dst)
+    {
+        std::memcpy(static_cast<void *>(dst), lines + static_cast<size_t>(p) * TUPLES_PER_LINE, fill[p] * sizeof(TupleT));
+        fill[p] = 0;
+    }
+
+    // Order the weakly-ordered streaming stores before the output is handed to other threads
+    void finish() const { _mm_sfence(); }
+};
+
+/* One combiner per worker, kept by the output across runs: only a change of partition count or
+   streaming kernel rebuilds one, so repeated runs allocate nothing. Every drain empties the lines.
+*/
+template <typename TupleT>
+using WriteCombiners = std::vector<std::unique_ptr<WriteCombiner<TupleT>>>;
+
+template <typename TupleT>
+void reserve_combiners(WriteCombiners<TupleT> &combiners, uint32_t threads, uint32_t partitions, StreamLineFn stream)
+{
+    if (combiners.size() < threads)
+        combiners.resize(threads);
+    for (uint32_t t = 0; t < threads; ++t)
+        if (!combiners[t] || combiners[t]->num_partitions != partitions || combiners[t]->stream_line != stream)
+            combiners[t] = std::make_unique<WriteCombiner<TupleT>>(partitions, stream);
+}
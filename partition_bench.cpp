@@ -0,0 +1,348 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "partition/bench_config.h"
+#include "partition/bench_report.h"
+#include "partition/perf_counters.h"
+#include "partition/timeline.h"
+
+static void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [--config=<file.json>] [--key=value ...]\n"
+              << "  --strategy=concurrent,independent,count_then_move,parallel_buffers,multi_pass,columnar,auto\n"
+              << "  --hash=mask|multiplicative|range  --threads=1,2,4  --bits=4,6,8  --tuples=<n>  --width=8,16,32,64\n"
+              << "  --pinning=none|compact|scatter|physical-cores-first|smt-pairs|node<N>|<core>,<core>,...\n"
+              << "  --scatter=direct|swwc  --pages=4k|thp|2m|1g  --numa=first-touch|local|interleave|node<N>\n"
+              << "  --buffers=fixed|skew-resilient|growable  --input=<distribution>  --seed=<n>\n"
+              << "  --schedule=morsel|static  --morsel=<tuples>\n"
+              << "  --warmups=<n>  --repeats=<n>  --format=csv|json  --output=<file>\n"
+              << "  --counters=on|off  --details-output=<file>  --trace=<file>\n"
+              << "Every strategy, thread count and hash bits combination is run warmups + repeats times;\n"
+              << "the repeats are summarized (median, p5/p95, mean, stddev, 95% CI) in nanoseconds and MTuple/s.\n"
+              << "With counters, every worker counts hardware and software events during the measured runs;\n"
+              << "rows get the totals per run and details per worker and phase.\n"
+              << "Rows also report the load imbalance and straggler of the workers, and --trace writes their\n"
+              << "timelines as Chrome trace JSON.\n"
+              << "auto calibrates the machine once and runs the strategy (and multi-pass passes) its cost model\n"
+              << "predicts fastest for each thread count and bits; the row's strategy names the choice.\n"
+              << "range partitions into 2^bits key ranges; the splitters are sampled from the input before the runs.\n"
+              << "--width sets the row bytes (8B rows are bare keys). columnar partitions the same input stored as\n"
+              << "columns: the keys and width / 8 - 1 payload columns, all moved with one partition id vector.\n"
+              << "Workers take the input in morsels (16K tuples by default), their own chunk's first, and steal\n"
+              << "the others' once done; static gives every worker one fixed chunk.\n";
+}
+
+// Counter totals per run as metrics, and per run values of every worker and phase as details
+static void add_counters(const PerfCounters &counters, BenchRow &row)
+{
+    const double runs = std::max(1u, counters.runs());
+    auto metrics = [&](const CounterValues &values, BenchMetrics &m)
+    {
+        for (size_t e = 0; e < NUM_COUNTER_EVENTS; ++e)
+            if (counters.available(static_cast<CounterEvent>(e)))
+                m.emplace_back(counter_event_name(static_cast<CounterEvent>(e)), values.values[e] / runs);
+    };
+
+    const CounterValues total = counters.total();
+    metrics(total, row.metrics);
+    if (counters.available(CounterEvent::Cycles) && counters.available(CounterEvent::Instructions))
+        row.metrics.emplace_back("ipc", total[CounterEvent::Instructions] / total[CounterEvent::Cycles]);
+    for (uint32_t t = 0; t < counters.threads(); ++t)
+        for (uint32_t k = 0; k < counters.phases(t).size(); ++k)
+            metrics(counters.phases(t)[k], row.detail(t, std::to_string(k)));
+}
+
+/* Load balance of the measured runs: the imbalance and straggler as metrics; busy and waiting
+   time per worker and phase, and every worker's input tuples and rate, as details (per run).
+   `worker_tuples` holds the input tuples each worker took per run (its morsels).
+   A worker's bandwidth counts one read and one write of each `row_bytes` tuple it took.
+*/
+static void add_load(const WorkerTimeline &timeline, const std::vector<double> &worker_tuples, size_t row_bytes,
+                     BenchRow &row)
+{
+    const LoadBalance load = analyze_load(timeline);
+    const double runs = std::max(1u, timeline.runs());
+    const uint32_t threads = timeline.threads();
+    uint32_t worst_phase = 0;
+    for (uint32_t k = 0; k < load.phase_imbalance.size(); ++k)
+        if (load.phase_imbalance[k] > load.phase_imbalance[worst_phase])
+            worst_phase = k;
+    row.metrics.emplace_back("imbalance", load.imbalance);
+    row.metrics.emplace_back("straggler", load.straggler);
+    row.metrics.emplace_back("worst_phase", worst_phase);
+    row.metrics.emplace_back("worst_phase_imbalance", load.phase_imbalance.empty() ? 1.0 : load.phase_imbalance[worst_phase]);
+
+    for (uint32_t t = 0; t < threads; ++t)
+    {
+        const double count = worker_tuples[t];
+        const double busy = load.busy_seconds[t] / runs;
+        BenchMetrics &all = row.detail(t, "all");
+        all.emplace_back("busy_ns", busy * 1e9);
+        all.emplace_back("waited_ns", load.waited_seconds[t] / runs * 1e9);
+        all.emplace_back("tuples", count);
+        all.emplace_back("mtps", busy > 0.0 ? count / busy / 1e6 : 0.0);
+        all.emplace_back("gbps", busy > 0.0 ? 2.0 * count * row_bytes / busy / 1e9 : 0.0);
+        for (uint32_t k = 0; k < load.phase_seconds.size(); ++k)
+            row.detail(t, std::to_string(k)).emplace_back("busy_ns", load.phase_seconds[k][t] / runs * 1e9);
+    }
+}
+
+/* Warm-up and measured runs of one case on `pool`; false if a run failed. `run_once()`
+   partitions once on the pool and returns false on failure.
+   Warm-ups let the output buffers be allocated, placed and faulted in before measuring;
+   only the measured runs are seen by `observer`, whose own overhead is taken off their times.
+*/
+template <typename RunOnce>
+bool measure_case(WorkerPool &pool, int warmups, int repeats, RunObserver *observer, RunOnce &&run_once, BenchRow &row)
+{
+    for (int i = 0; i < warmups + repeats; ++i)
+    {
+        if (i == warmups)
+            pool.observe(observer);
+        bool ok = run_once();
+        if (!ok || i + 1 == warmups + repeats)
+            pool.observe(nullptr);
+        if (!ok)
+            return false;
+        const WorkerRun &run = pool.last_run();
+        if (i >= warmups)
+        {
+            const double seconds = std::chrono::duration<double>(run.finished - run.started).count() -
+                                   (observer ? observer->overhead_seconds() : 0.0);
+            row.samples_ns.push_back(static_cast<uint64_t>(std::max(seconds, 1e-9) * 1e9));
+        }
+    }
+    return true;
+}
+
+/* `partition()` wrapped for measure_case: the measured runs (those after `warmups` calls) add
+   the tuples every worker took, over `repeats`, to `worker_tuples`
+*/
+template <typename Result, typename Partition>
+auto counting_worker_tuples(Result &result, int warmups, int repeats, std::vector<double> &worker_tuples,
+                            Partition &&partition)
+{
+    return [&result, &worker_tuples, partition = std::forward<Partition>(partition), warmups, repeats, calls = 0]() mutable
+    {
+        if (!partition())
+            return false;
+        if (calls++ >= warmups)
+        {
+            const std::vector<size_t> tuples = result.schedule.worker_tuples();
+            worker_tuples.resize(tuples.size());
+            for (size_t t = 0; t < tuples.size(); ++t)
+                worker_tuples[t] += static_cast<double>(tuples[t]) / repeats;
+        }
+        return true;
+    };
+}
+
+template <typename Strategy, typename HashFn, typename TupleT>
+bool run_case(const TupleT *input, size_t tuples, uint32_t bits, WorkerPool &pool, const PartitionOptions &opts,
+              HashFn hash, int warmups, int repeats, RunObserver *observer, std::vector<double> &worker_tuples, BenchRow &row)
+{
+    PartitionResult<typename Strategy::template Output<TupleT>> result;
+    row.tuples = tuples;
+    return measure_case(pool, warmups, repeats, observer, counting_worker_tuples(result, warmups, repeats, worker_tuples, [&]
+                                                                                  { return partition_into<Strategy, HashFn>(result, input, tuples, bits, pool, opts, hash); }),
+                        row);
+}
+
+template <typename HashFn>
+bool run_columnar_case(const ColumnInput<uint64_t> &input, size_t tuples, uint32_t bits, WorkerPool &pool,
+                       const PartitionOptions &opts, HashFn hash, int warmups, int repeats, RunObserver *observer,
+                       std::vector<double> &worker_tuples, BenchRow &row)
+{
+    PartitionResult<ColumnarPartitions<uint64_t>> result;
+    row.tuples = tuples;
+    return measure_case(pool, warmups, repeats, observer, counting_worker_tuples(result, warmups, repeats, worker_tuples, [&]
+                                                                                  { return partition_columns_into(result, input, tuples, bits, pool, opts, hash); }),
+                        row);
+}
+
+// Per-pool state shared by the cases of one thread count
+struct PoolCases
+{
+    uint32_t threads;
+    PartitionOptions opts;
+    WorkerPool &pool;
+    WorkerTimeline &timeline;
+    PerfCounters *counters;
+    RunObserver *observers;
+};
+
+/* Every strategy and bits case on rows of TupleT, and in columns for the columnar strategy;
+   false if a case failed
+*/
+template <typename TupleT>
+bool run_width(const BenchConfig &config, PoolCases &cases, BenchReport &report, ChromeTrace &trace)
+{
+    const uint32_t threads = cases.threads;
+    const PartitionOptions &opts = cases.opts;
+    WorkerPool &pool = cases.pool;
+    AlignedArray<TupleT> input = prepare_input<TupleT>(pool, opts, config.input, config.tuples);
+    std::map<uint32_t, SplitterTree> trees;  // range hash: per bits, over this input
+    std::unique_ptr<RowColumns<TupleT>> columns; // columnar: the same input split into columns
+    bool ok = true;
+    for (const std::string &strategy : config.strategies)
+    {
+        for (uint32_t bits : config.bits)
+        {
+            BenchRow row;
+            row.fields = {{"strategy", strategy},
+                          {"hash", config.hash},
+                          {"threads", std::to_string(threads)},
+                          {"bits", std::to_string(bits)},
+                          {"tuples", std::to_string(config.tuples)},
+                          {"width", std::to_string(sizeof(TupleT))},
+                          {"input", describe_input(config.input)},
+                          {"pinning", config.pinning},
+                          {"scatter", scatter_mode_name(opts.scatter)},
+                          {"pages", page_size_name(input.backing())},
+                          {"numa", numa_policy_name(opts.numa)},
+                          {"buffers", buffer_sizing_name(opts.buffers)},
+                          {"schedule", schedule_name(opts.schedule)},
+                          {"warmups", std::to_string(config.warmups)}};
+            // auto: the strategy and passes the cost model predicts fastest on this pool
+            std::string chosen = strategy;
+            PartitionOptions case_opts = opts;
+            if (strategy == AUTO_STRATEGY)
+            {
+                const MachineProfile &profile = machine_profile();
+                const StrategyChoice choice = choose_strategy(profile, bits, config.tuples, threads, opts, sizeof(TupleT));
+                const StrategyChoice best = choose_plan(profile, bits, config.tuples, threads, opts, sizeof(TupleT));
+                std::cerr << "Auto: " << bits << " bits on " << threads << " threads -> " << describe_choice(choice);
+                if (best.threads != threads)
+                    std::cerr << "; fastest with up to " << threads << " threads: " << describe_choice(best);
+                std::cerr << "\n";
+                chosen = choice.strategy;
+                case_opts = apply_choice(choice, opts);
+                row.fields[0].second += ":" + chosen + (choice.passes > 1 ? "/" + std::to_string(choice.passes) : "");
+            }
+            if (config.hash == RangeHash::name && !trees.count(bits))
+            {
+                auto begin = std::chrono::steady_clock::now();
+                const SplitterTree &tree = trees[bits] = build_splitter_tree(input.get(), config.tuples, bits);
+                std::cerr << "Splitters: " << bits << " bits, " << tree.levels() << " levels, " << tree.bytes() / 1024
+                          << " KB tree, built in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count()
+                          << " s\n";
+            }
+            const bool columnar = chosen == ColumnarCountThenMove::name;
+            if (columnar && !columns)
+                columns = std::make_unique<RowColumns<TupleT>>(input.get(), config.tuples);
+            cases.timeline.clear();
+            if (cases.counters)
+                cases.counters->clear();
+            bool measured = false;
+            std::vector<double> worker_tuples(threads, 0.0);
+            auto run_with = [&](auto hash)
+            {
+                using HashFn = decltype(hash);
+                if (columnar)
+                    measured = run_columnar_case(columns->input(), config.tuples, bits, pool, case_opts, hash,
+                                                 config.warmups, config.repeats, cases.observers, worker_tuples, row);
+                else
+                    visit_strategy(chosen, [&](auto s)
+                                   { measured = run_case<typename decltype(s)::type, HashFn>(
+                                         input.get(), config.tuples, bits, pool, case_opts, hash, config.warmups, config.repeats,
+                                         cases.observers, worker_tuples, row); });
+            };
+            if (config.hash == RangeHash::name)
+                run_with(RangeHash{&trees[bits]});
+            else
+                visit_hash(config.hash, [&](auto h)
+                           { run_with(typename decltype(h)::type{}); });
+            if (measured)
+            {
+                add_load(cases.timeline, worker_tuples, sizeof(TupleT), row);
+                if (cases.counters)
+                    add_counters(*cases.counters, row);
+                report.add(row);
+                if (!config.trace.empty())
+                    trace.add(row.fields[0].second + ", " + std::to_string(threads) + " threads, " + std::to_string(bits) + " bits, " +
+                                  std::to_string(sizeof(TupleT)) + "B rows",
+                              cases.timeline);
+            }
+            else
+            {
+                std::cerr << "Skipping " << strategy << " with " << threads << " threads, " << bits << " bits and "
+                          << sizeof(TupleT) << "B rows\n";
+                ok = false;
+            }
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    BenchConfig config;
+    if (!parse_bench_args(argc, argv, config))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::ofstream file;
+    if (!config.output.empty())
+    {
+        file.open(config.output);
+        if (!file)
+        {
+            std::cerr << "Cannot create " << config.output << "\n";
+            return 1;
+        }
+    }
+    std::ofstream details;
+    if (!config.details_output.empty())
+    {
+        details.open(config.details_output);
+        if (!details)
+        {
+            std::cerr << "Cannot create " << config.details_output << "\n";
+            return 1;
+        }
+    }
+    BenchReport report(config.output.empty() ? std::cout : file, config.format,
+                       config.details_output.empty() ? nullptr : &details);
+
+    ChromeTrace trace;
+    bool ok = true;
+    for (uint32_t threads : config.threads)
+    {
+        PartitionOptions opts = config.opts;
+        resolve_pinning(config.pinning, threads, opts.cores);
+
+        WorkerPool pool(threads, opts.cores);
+        WorkerTimeline timeline(threads);
+        std::unique_ptr<PerfCounters> counters;
+        std::vector<RunObserver *> observed = {&timeline};
+        if (config.counters)
+        {
+            counters = std::make_unique<PerfCounters>(threads);
+            observed.push_back(counters.get());
+        }
+        RunObservers observers(observed);
+        PoolCases cases{threads, opts, pool, timeline, counters.get(), &observers};
+        for (uint32_t width : config.widths)
+            visit_tuple_width(width, [&](auto w)
+                              { ok = run_width<typename decltype(w)::type>(config, cases, report, trace) && ok; });
+    }
+    report.finish();
+    if (!config.trace.empty())
+    {
+        std::ofstream trace_file(config.trace);
+        trace.write(trace_file);
+        if (!trace_file)
+        {
+            std::cerr << "Write of " << config.trace << " failed\n";
+            ok = false;
+        }
+    }
+    return ok ? 0 : EXIT_FAILURE;
+}
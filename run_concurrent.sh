@@ -21,98 +21,53 @@ mkdir -p ./perf_logs
 
 PROGRAM=./concurrent_output_affinity
 
-# CPU groupings based on NUMA layout (from numactl output)
-NODE0_ADJACENT=(0 2 4 6 8 10 12 14 16 18 20 22 24 26 28 30)
-NODE1_ADJACENT=(1 3 5 7 9 11 13 15 17 19 21 23 25 27 29 31)
-
-# Generate CPU sets
-get_adjacent_cores() {
-  local -n array=$1
-  local count=$2
-  local result=("${array[@]:0:$count}")
-  echo "${result[@]}"
-}
-
-get_alternating_cores() {
-  local -n array=$1
-  local count=$2
-  local result=()
-  for ((i=0; i<$count; i++)); do
-    result+=("${array[$((i*2))]}")
-  done
-  echo "${result[@]}"
-}
-
-get_cross_numa_cores() {
-  local -n node0=$1
-  local -n node1=$2
-  local count=$3
-  local result=()
-  for ((i=0; i<$count; i++)); do
-    if ((i % 2 == 0)); then
-      result+=("${node0[$((i/2))]}")
-    else
-      result+=("${node1[$((i/2))]}")
-    fi
-  done
-  echo "${result[@]}"
-}
+# NUMA nodes of this machine; the cores themselves are chosen by the program's pinning policies
+NODES=()
+for dir in /sys/devices/system/node/node[0-9]*; do
+  NODES+=("${dir##*/}")
+done
+if (( ${#NODES[@]} == 0 )); then
+  NODES=(node0)
+fi
 
-# Run the program with a label and core list, including perf output
+# Run the program with a label and its arguments (<threads> <pinning policy> [num_pus]), including perf output
 run_affinity_case() {
   local label="$1"
   shift
-  local cores=("$@")
-  local core_args="${#cores[@]} ${cores[@]}"
-  echo "Running case: $label on cores: ${cores[*]}"
-  echo "Running: $PROGRAM $core_args"
-  echo "ARGS: $PROGRAM $core_args"
+  echo "Running case: $label"
+  echo "ARGS: $PROGRAM $*"
 
-  $PROGRAM $core_args > ./affinity_results/concurrent_${label}.csv
+  $PROGRAM "$@" > ./affinity_results/concurrent_${label}.csv
 
   perf stat -e cycles,instructions,cache-misses,L1-dcache-load-misses,LLC-load-misses \
-    $PROGRAM $core_args &> ./perf_logs/perf_${label}.txt
+    $PROGRAM "$@" &> ./perf_logs/perf_${label}.txt
 }
 
 # Thread counts to test
 THREAD_COUNTS=(1 2 4 8 16 32)
 
-echo "Detected cores (node0): ${NODE0_ADJACENT[*]}"
+echo "Detected nodes: ${NODES[*]}"
 
 for threads in "${THREAD_COUNTS[@]}"; do
   echo "\n=== Start running thread count: $threads ==="
 
-  # Same NUMA node, adjacent cores
-  run_affinity_case "node0_adjacent_${threads}" $(get_adjacent_cores NODE0_ADJACENT $threads)
-  run_affinity_case "node1_adjacent_${threads}" $(get_adjacent_cores NODE1_ADJACENT $threads)
-
-  # Alternating cores on Node 0 and Node 1 (if possible)
-  if (( threads * 2 <= ${#NODE0_ADJACENT[@]} )); then
-    run_affinity_case "node0_alternating_${threads}" $(get_alternating_cores NODE0_ADJACENT $threads)
-  fi
-  if (( threads * 2 <= ${#NODE1_ADJACENT[@]} )); then
-    run_affinity_case "node1_alternating_${threads}" $(get_alternating_cores NODE1_ADJACENT $threads)
-  fi
-
-  # Cross NUMA
-  run_affinity_case "crossnuma_${threads}" $(get_cross_numa_cores NODE0_ADJACENT NODE1_ADJACENT $threads)
-
-  # Oversubscription cases on Node 0 and Node 1
-  if (( threads >= 4 )); then
-    run_affinity_case "oversub_node0_${threads}on2" $(get_adjacent_cores NODE0_ADJACENT 2)
-    run_affinity_case "oversub_node1_${threads}on2" $(get_adjacent_cores NODE1_ADJACENT 2)
-  fi
-  if (( threads >= 8 )); then
-    run_affinity_case "oversub_node0_${threads}on4" $(get_adjacent_cores NODE0_ADJACENT 4)
-    run_affinity_case "oversub_node1_${threads}on4" $(get_adjacent_cores NODE1_ADJACENT 4)
-  fi
-  if (( threads >= 16 )); then
-    run_affinity_case "oversub_node0_${threads}on8" $(get_adjacent_cores NODE0_ADJACENT 8)
-    run_affinity_case "oversub_node1_${threads}on8" $(get_adjacent_cores NODE1_ADJACENT 8)
-  fi
-  if (( threads >= 32 )); then
-    run_affinity_case "oversub_node0_${threads}on16" $(get_adjacent_cores NODE0_ADJACENT 16)
-    run_affinity_case "oversub_node1_${threads}on16" $(get_adjacent_cores NODE1_ADJACENT 16)
-  fi
+  for node in "${NODES[@]}"; do
+    # Same NUMA node, physical cores first
+    run_affinity_case "${node}_adjacent_${threads}" $threads $node
+
+    # Oversubscription: all threads on 2, 4, 8 or 16 PUs of one node
+    for pus in 2 4 8 16; do
+      if (( threads >= pus * 2 )); then
+        run_affinity_case "oversub_${node}_${threads}on${pus}" $threads $node $pus
+      fi
+    done
+  done
+
+  # SMT siblings next to each other, and all physical cores before any sibling
+  run_affinity_case "smt_pairs_${threads}" $threads smt-pairs
+  run_affinity_case "physical_cores_first_${threads}" $threads physical-cores-first
+
+  # Cross NUMA: alternate between nodes
+  run_affinity_case "crossnuma_${threads}" $threads scatter
 
 done
@@ -0,0 +1,58 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "partition/benchmark.h"
+#include "partition/streaming.h"
+
+static void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " generate <file> <tuples> [uniform|zipf[:theta]|selfsimilar[:h]|sequential|duplicates[:distinct]]\n"
+              << "       " << program << " <input file> <output dir> <threads> <hash_bits> [block_mb] [sync|threads|uring] [direct|buffered]\n"
+              << "Partitions a file of 16-byte tuples that need not fit in memory into output_dir/part-<p>.bin,\n"
+              << "spilling with io_uring (default), a pwrite thread pool or synchronous writes.\n";
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 4 && std::string(argv[1]) == "generate")
+    {
+        InputSpec spec;
+        if (argc > 4 && !parse_input_spec(argv[4], spec))
+        {
+            usage(argv[0]);
+            return 1;
+        }
+        WorkerPool pool(std::max(1u, std::thread::hardware_concurrency()));
+        return write_input_file(argv[2], std::stoull(argv[3]), spec, pool) ? 0 : 1;
+    }
+
+    PartitionOptions opts;
+    SpillOptions spill;
+    if (argc < 5 || (argc > 6 && !parse_spill_io(argv[6], spill.io)) ||
+        (argc > 7 && std::string(argv[7]) != "direct" && std::string(argv[7]) != "buffered"))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    uint32_t threads = std::stoi(argv[3]);
+    uint32_t bits = std::stoi(argv[4]);
+    size_t block_tuples = STREAM_BLOCK_BYTES / sizeof(Tuple);
+    if (argc > 5)
+        block_tuples = (std::stoull(argv[5]) << 20) / sizeof(Tuple);
+    spill.direct = argc > 7 && std::string(argv[7]) == "direct";
+
+    WorkerPool pool(threads, opts.cores);
+    StreamingResult result = stream_partition(argv[1], argv[2], bits, pool, opts, block_tuples, spill);
+    if (!result.ok)
+        return EXIT_FAILURE;
+
+    std::cout << "Tuples: " << result.tuples << " in " << result.blocks << " blocks, "
+              << result.seconds * 1000.0 << " ms (partitioning " << result.partition_seconds * 1000.0
+              << " ms, waiting for reads " << result.read_wait_seconds * 1000.0 << " ms)\n";
+    std::cout << "Spill: " << spill_io_name(result.io) << (result.direct ? ", O_DIRECT" : ", buffered") << ", "
+              << result.bytes_written / (1 << 20) << " MiB\n";
+    std::cout << "Threads: " << threads << ", Hash Bits: " << bits << ", Throughput: " << result.throughput()
+              << " MTuple/s, Write bandwidth: " << result.write_bandwidth() << " MB/s\n";
+    return 0;
+}